@@ -0,0 +1,28 @@
+#pragma once
+
+#include "structured_matrix_value_generator.hh"
+
+/* Generates nonzeros only within a band around the main diagonal:
+ * cell (i, j) may be nonzero iff i - lower_bandwidth <= j <= i + upper_bandwidth.
+ */
+template <class V>
+class banded_matrix_value_generator : public structured_matrix_value_generator<V> {
+private:
+    size_t _lower_bandwidth, _upper_bandwidth;
+
+protected:
+    std::pair<size_t, size_t> row_columns(size_t row) override {
+        return this->clamp_columns(static_cast<long long>(row) - static_cast<long long>(_lower_bandwidth),
+                                   static_cast<long long>(row + _upper_bandwidth) + 1);
+    }
+
+public:
+    banded_matrix_value_generator(size_t height, size_t width, size_t lower_bandwidth, size_t upper_bandwidth,
+                                  size_t suggested_number_of_values, int seed,
+                                  std::shared_ptr<matrix_value_factory<V>> matrix_value_factory)
+            : structured_matrix_value_generator<V>(height, width, suggested_number_of_values, seed,
+                                                   std::move(matrix_value_factory)),
+              _lower_bandwidth(lower_bandwidth), _upper_bandwidth(upper_bandwidth) {
+        this->start();
+    }
+};
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "matrix_value_generator.hh"
+#include "sparse_matrix_value_generator.hh"
+
+/* Packed binary matrix file format.
+ *
+ * The file starts with binary_matrix_header, followed by
+ *  - COO layout: nnz records {uint64 i, uint64 j, V val},
+ *  - CSR layout: height + 1 uint64 row offsets, then nnz records {uint64 j, V val}.
+ * Records are sorted in row-major order and naturally aligned, so the file can be
+ * iterated in place after mapping it into memory. Indices are 1-based, as in matrix_value.
+ */
+enum class binary_matrix_layout : uint32_t {
+    COO = 0,
+    CSR = 1
+};
+
+struct binary_matrix_header {
+    static constexpr char expected_magic[8] = {'S', 'M', 'T', 'B', 'I', 'N', '\0', '\0'};
+    static constexpr uint32_t current_version = 1;
+
+    char magic[8];
+    uint32_t version;
+    binary_matrix_layout layout;
+    uint32_t value_size;
+    uint32_t reserved;
+    uint64_t height, width, nnz;
+};
+
+template <class V>
+struct binary_matrix_coo_record {
+    uint64_t i, j;
+    V val;
+};
+
+template <class V>
+struct binary_matrix_csr_record {
+    uint64_t j;
+    V val;
+};
+
+/* Dumps all values of the generator to a binary matrix file. Returns the number of values written.
+ * Throws if the rows of the values are out of the generator's height or out of order.
+ */
+template <class V>
+size_t write_binary_matrix(matrix_value_generator<V>& gen, const std::string& path,
+                           binary_matrix_layout layout = binary_matrix_layout::COO) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot open " + path + " for writing");
+    }
+
+    binary_matrix_header header{};
+    std::memcpy(header.magic, binary_matrix_header::expected_magic, sizeof(header.magic));
+    header.version = binary_matrix_header::current_version;
+    header.layout = layout;
+    header.value_size = sizeof(V);
+    header.height = gen.height();
+    header.width = gen.width();
+
+    /* Row offsets are only known after all values are written, so the records go first */
+    std::vector<uint64_t> row_offsets;
+    std::streamoff records_begin = sizeof(header);
+    if (layout == binary_matrix_layout::CSR) {
+        row_offsets.assign(header.height + 1, 0);
+        records_begin += row_offsets.size() * sizeof(uint64_t);
+    }
+    out.seekp(records_begin);
+
+    uint64_t last_row = 0;
+    uint64_t previous_row = 0;
+    std::vector<matrix_value<V>> batch;
+    batch.reserve(matrix_value_generator<V>::default_batch_size);
+
+    while (gen.next_batch(batch, matrix_value_generator<V>::default_batch_size) > 0) {
+        for (auto& value : batch) {
+            if (value.i < 1 || value.i > header.height) {
+                throw std::runtime_error("Row " + std::to_string(value.i) + " out of range of a matrix of height "
+                                         + std::to_string(header.height));
+            }
+            if (value.i < previous_row) {
+                throw std::runtime_error("Row " + std::to_string(value.i) + " after row " + std::to_string(previous_row)
+                                         + ": values are not in row-major order");
+            }
+            previous_row = value.i;
+        }
+
+        if (layout == binary_matrix_layout::COO) {
+            std::vector<binary_matrix_coo_record<V>> records;
+            records.reserve(batch.size());
+            for (auto& value : batch) {
+                records.push_back({value.i, value.j, value.val});
+            }
+            out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(records[0]));
+        } else {
+            std::vector<binary_matrix_csr_record<V>> records;
+            records.reserve(batch.size());
+            for (auto& value : batch) {
+                while (last_row < value.i) {
+                    row_offsets[last_row++] = header.nnz + records.size();
+                }
+                records.push_back({value.j, value.val});
+            }
+            out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(records[0]));
+        }
+        header.nnz += batch.size();
+        batch.clear();
+    }
+
+    if (layout == binary_matrix_layout::CSR) {
+        while (last_row <= header.height) {
+            row_offsets[last_row++] = header.nnz;
+        }
+        out.seekp(sizeof(header));
+        out.write(reinterpret_cast<const char*>(row_offsets.data()), row_offsets.size() * sizeof(uint64_t));
+    }
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!out) {
+        throw std::runtime_error("Error while writing " + path);
+    }
+
+    return header.nnz;
+}
+
+/* Iterates a binary matrix file in place, without copying it into a user-space buffer. */
+template <class V>
+class binary_matrix_value_generator : public matrix_value_generator<V> {
+private:
+    int _fd;
+    const char* _data;
+    size_t _size;
+    const binary_matrix_header* _header;
+    const uint64_t* _row_offsets;
+    const binary_matrix_coo_record<V>* _coo_records;
+    const binary_matrix_csr_record<V>* _csr_records;
+    size_t _next_idx;
+    size_t _row;
+
+    /* Checks the header against the mapped size and, for CSR files, that the row offsets start at 0,
+     * never decrease and end at nnz, so that iterating the records stays within the mapping.
+     */
+    bool valid_file() const {
+        if (std::memcmp(_header->magic, binary_matrix_header::expected_magic, sizeof(_header->magic)) != 0
+            || _header->version != binary_matrix_header::current_version
+            || _header->value_size != sizeof(V)) {
+            return false;
+        }
+
+        size_t available = _size - sizeof(binary_matrix_header);
+        size_t record_size;
+        if (_header->layout == binary_matrix_layout::COO) {
+            record_size = sizeof(binary_matrix_coo_record<V>);
+        } else if (_header->layout == binary_matrix_layout::CSR) {
+            if (_header->height >= available / sizeof(uint64_t)) {
+                return false;
+            }
+            available -= (_header->height + 1) * sizeof(uint64_t);
+            record_size = sizeof(binary_matrix_csr_record<V>);
+        } else {
+            return false;
+        }
+        if (_header->nnz > available / record_size) {
+            return false;
+        }
+
+        if (_header->layout == binary_matrix_layout::CSR) {
+            const uint64_t* offsets = reinterpret_cast<const uint64_t*>(_data + sizeof(binary_matrix_header));
+            if (offsets[0] != 0 || offsets[_header->height] != _header->nnz) {
+                return false;
+            }
+            for (uint64_t row = 0; row < _header->height; row++) {
+                if (offsets[row + 1] < offsets[row]) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    matrix_value<V> _take() {
+        if (_coo_records != nullptr) {
+            const auto& record = _coo_records[_next_idx++];
+            return matrix_value<V>(record.i, record.j, record.val);
+        }
+
+        while (_row_offsets[_row] <= _next_idx) {
+            _row++;
+        }
+        const auto& record = _csr_records[_next_idx++];
+        return matrix_value<V>(_row, record.j, record.val);
+    }
+
+public:
+    explicit binary_matrix_value_generator(const std::string& path)
+            : _fd(-1), _data(nullptr), _size(0), _header(nullptr), _row_offsets(nullptr),
+              _coo_records(nullptr), _csr_records(nullptr), _next_idx(0), _row(0) {
+        _fd = open(path.c_str(), O_RDONLY);
+        if (_fd < 0) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+
+        struct stat file_stat{};
+        if (fstat(_fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(binary_matrix_header)) {
+            close(_fd);
+            throw std::runtime_error("Not a binary matrix file: " + path);
+        }
+        _size = file_stat.st_size;
+
+        void* mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(_fd);
+            throw std::runtime_error("Cannot map " + path);
+        }
+        madvise(mapped, _size, MADV_SEQUENTIAL);
+        _data = static_cast<const char*>(mapped);
+        _header = reinterpret_cast<const binary_matrix_header*>(_data);
+
+        if (!valid_file()) {
+            munmap(mapped, _size);
+            close(_fd);
+            throw std::runtime_error("Invalid or truncated binary matrix file: " + path);
+        }
+
+        size_t records_begin = sizeof(binary_matrix_header);
+        if (_header->layout == binary_matrix_layout::CSR) {
+            _row_offsets = reinterpret_cast<const uint64_t*>(_data + sizeof(binary_matrix_header));
+            records_begin += (_header->height + 1) * sizeof(uint64_t);
+            _csr_records = reinterpret_cast<const binary_matrix_csr_record<V>*>(_data + records_begin);
+        } else {
+            _coo_records = reinterpret_cast<const binary_matrix_coo_record<V>*>(_data + records_begin);
+        }
+    }
+
+    binary_matrix_value_generator(const binary_matrix_value_generator&) = delete;
+    binary_matrix_value_generator& operator=(const binary_matrix_value_generator&) = delete;
+
+    ~binary_matrix_value_generator() {
+        munmap(const_cast<char*>(_data), _size);
+        close(_fd);
+    }
+
+    bool has_next() {
+        return _next_idx < _header->nnz;
+    }
+
+    matrix_value<V> next() {
+        if (!has_next()) {
+            throw no_next_value_exception();
+        }
+        return _take();
+    }
+
+    size_t next_batch(std::vector<matrix_value<V>>& out, size_t max_count) override {
+        size_t appended = std::min<size_t>(max_count, _header->nnz - _next_idx);
+        for (size_t k = 0; k < appended; k++) {
+            out.push_back(_take());
+        }
+        return appended;
+    }
+
+    size_t height() {
+        return _header->height;
+    }
+
+    size_t width() {
+        return _header->width;
+    }
+};
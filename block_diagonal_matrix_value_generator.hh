@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdexcept>
+#include "structured_matrix_value_generator.hh"
+
+/* Generates nonzeros only within square block_size x block_size blocks on the main diagonal.
+ * The last block is truncated to the matrix size.
+ */
+template <class V>
+class block_diagonal_matrix_value_generator : public structured_matrix_value_generator<V> {
+private:
+    size_t _block_size;
+
+protected:
+    std::pair<size_t, size_t> row_columns(size_t row) override {
+        long long first = static_cast<long long>((row - 1) / _block_size * _block_size) + 1;
+        return this->clamp_columns(first, first + static_cast<long long>(_block_size));
+    }
+
+public:
+    block_diagonal_matrix_value_generator(size_t height, size_t width, size_t block_size,
+                                          size_t suggested_number_of_values, int seed,
+                                          std::shared_ptr<matrix_value_factory<V>> matrix_value_factory)
+            : structured_matrix_value_generator<V>(height, width, suggested_number_of_values, seed,
+                                                   std::move(matrix_value_factory)),
+              _block_size(block_size) {
+        if (block_size == 0) {
+            throw std::runtime_error("Block size of a block diagonal matrix must be positive");
+        }
+        this->start();
+    }
+};
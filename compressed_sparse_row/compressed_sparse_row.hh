@@ -1,10 +1,20 @@
 #include <cassandra.h>
 #include <memory>
 #include <random>
+#include <algorithm>
+#include <functional>
 #include <map>
+#include <unordered_map>
 #include "../multiplicator.hh"
+#include "../utils/async_executor.hh"
+#include "../utils/batch_writer.hh"
 #include "../utils/connector.hh"
 #include "../utils/requestor.hh"
+#include "../utils/query_stats.hh"
+#include "csr_row_accumulator.hh"
+#include "csr_row_cache.hh"
+#include "csr_row_index.hh"
+#include "csr_value_chunk.hh"
 
 template<typename T>
 class CSR : public multiplicator<T> {
@@ -12,47 +22,216 @@ class CSR : public multiplicator<T> {
     const std::string _table_name_values = "csr_test_matrix_values";
     const std::string _table_name_rows = "csr_test_matrix_rows";
     const size_t _result_id = 100;
+    /* Values are stored in packed chunks of _chunk_values consecutive values. Values of every _bucket_rows rows
+     * form a partition, whose chunks are numbered from 0.
+     */
+    const size_t _chunk_values = 128;
+    const size_t _bucket_rows = 4096;
+    const std::string _select_rows_query =
+            "SELECT row, idx FROM " + _namespace + "." + _table_name_rows + " WHERE matrix_id=?;";
+    const std::string _select_bucket_query =
+            "SELECT vals FROM " + _namespace + "." + _table_name_values + " WHERE matrix_id=? AND bucket=?;";
+    const std::string _select_chunks_query =
+            "SELECT chunk, vals FROM " + _namespace + "." + _table_name_values +
+            " WHERE matrix_id=? AND bucket=? AND chunk>=? AND chunk<=?;";
+    const std::string _insert_chunk_query =
+            "INSERT INTO " + _namespace + "." + _table_name_values + " (matrix_id, bucket, chunk, vals) VALUES (?, ?, ?, ?);";
+    const std::string _insert_row_query =
+            "INSERT INTO " + _namespace + "." + _table_name_rows + " (matrix_id, row, idx) VALUES (?, ?, ?);";
     std::shared_ptr<connector> _conn;
+    async_executor _writer;
+    batch_writer _row_batches;
+    size_t _row_cache_bytes;
+    bool _pin_hot_rows;
+    bool _hypersparse;
     size_t _matrix_id;
     size_t _dimension;
+    /* Row pointers of every matrix, built while its rows are written or read once from the rows table */
+    std::map<size_t, csr_row_index> _row_indexes;
 
-    int get_row_begin(int row_num, int matrix_id) {
-        requestor query_row_begin(_conn);
-        int row_begin = -1;
+    /* Values of a matrix being written, grouped into chunks */
+    struct chunk_builder {
+        size_t matrix_id;
+        execution_profile profile;
+        size_t bucket = 0;
+        /* Index of the first value of the bucket */
+        size_t bucket_begin = 0;
+        /* Number of values appended so far */
+        size_t values = 0;
+        std::vector<matrix_value<T>> pending;
+    };
 
-        query_row_begin << "SELECT * FROM " << _namespace << "." << _table_name_rows
-                        << " WHERE matrix_id=" << matrix_id << " AND row=" << row_num << ";";
-        query_row_begin.send();
-        if (query_row_begin.next_row()) {
-            const CassValue* value_index = query_row_begin.get_column("idx");
-            cass_value_get_int32(value_index, &row_begin);
+    void submit_chunk(chunk_builder& builder) {
+        if (builder.pending.empty()) return;
+
+        std::vector<uint8_t> encoded;
+        encode_csr_chunk(builder.pending, encoded);
+        size_t chunk = (builder.values - builder.pending.size() - builder.bucket_begin) / _chunk_values;
+
+        requestor query(_conn, _insert_chunk_query);
+        query.set_profile(builder.profile);
+        query.bind((int32_t)builder.matrix_id, (int32_t)builder.bucket, (int32_t)chunk, encoded);
+        query.send(_writer);
+        builder.pending.clear();
+    }
+
+    /* Appends the next value of the matrix, in row-major order. Chunks restart at bucket boundaries. */
+    void append_value(chunk_builder& builder, const matrix_value<T>& value) {
+        size_t bucket = (value.i - 1) / _bucket_rows;
+        if (bucket != builder.bucket || builder.pending.size() == _chunk_values) {
+            submit_chunk(builder);
+        }
+        if (bucket != builder.bucket) {
+            builder.bucket = bucket;
+            builder.bucket_begin = builder.values;
+        }
+        builder.pending.push_back(value);
+        builder.values++;
+    }
+
+    /* Writes the pointer of the next stored row of the matrix, recording it in the row index as well */
+    void submit_row(size_t matrix_id, size_t row, size_t row_begin, execution_profile profile) {
+        requestor query_rows(_conn, _insert_row_query);
+        query_rows.set_profile(profile);
+        query_rows.bind((int32_t)matrix_id, (int32_t)row, (int32_t)row_begin);
+        query_rows.send(_row_batches, (int64_t)matrix_id);
+        _row_indexes.try_emplace(matrix_id, _hypersparse).first->second.push_back(row, row_begin);
+    }
+
+    const csr_row_index& get_row_index(size_t matrix_id, execution_profile profile) {
+        auto it = _row_indexes.find(matrix_id);
+        if (it != _row_indexes.end()) {
+            return it->second;
+        }
+
+        requestor query_rows(_conn, _select_rows_query);
+        query_rows.set_profile(profile);
+        query_rows.bind((int32_t)matrix_id);
+        query_rows.send();
+        size_t row_index = query_rows.column_index("row");
+        size_t idx_index = query_rows.column_index("idx");
+
+        csr_row_index index(_hypersparse);
+        while (query_rows.next_row()) {
+            index.push_back(query_rows.get<int32_t>(row_index), query_rows.get<int32_t>(idx_index));
         }
-        return row_begin;
+        return _row_indexes.emplace(matrix_id, std::move(index)).first->second;
     }
 
-    std::vector<matrix_value<T>> get_row(int i, int matrix_id) {
-        int row_begin = get_row_begin(i, matrix_id);
-        int row_end = get_row_begin(i+1, matrix_id);
+    std::vector<matrix_value<T>> get_row(int i, int matrix_id, execution_profile profile = execution_profile::standard) {
+        const csr_row_index& index = get_row_index(matrix_id, profile);
+        auto [row_begin, row_end] = index.row_range(i);
 
         std::vector<matrix_value<T>> values;
-        requestor query_values(_conn);
-        query_values << "SELECT * FROM " << _namespace << "." << _table_name_values
-                << " WHERE matrix_id=" << matrix_id << " AND idx>=" << row_begin << " AND idx<" << row_end << ";";
+        if (row_begin == row_end) {
+            return values;
+        }
+
+        /* Chunks of the bucket are counted from its first value, which is where its first row begins */
+        size_t bucket = (i - 1) / _bucket_rows;
+        size_t bucket_begin = index.row_begin(bucket * _bucket_rows + 1);
+        size_t first_chunk = (row_begin - bucket_begin) / _chunk_values;
+        size_t last_chunk = (row_end - 1 - bucket_begin) / _chunk_values;
+
+        requestor query_values(_conn, _select_chunks_query);
+        query_values.set_profile(profile);
+        query_values.bind((int32_t)matrix_id, (int32_t)bucket, (int32_t)first_chunk, (int32_t)last_chunk);
         query_values.send();
+        size_t chunk_index = query_values.column_index("chunk");
+        size_t vals_index = query_values.column_index("vals");
+        values.reserve(row_end - row_begin);
         while (query_values.next_row()) {
-            const CassValue* value_col = query_values.get_column("column");
-            const CassValue* value_val = query_values.get_column("value");
-            int j;
-            T val;
-            cass_value_get_int32(value_col, &j);
-            cass_value_get_float(value_val, &val);
-            values.emplace_back(i, j, val);
+            size_t chunk_begin = bucket_begin + query_values.get<int32_t>(chunk_index) * _chunk_values;
+            const cass_byte_t* data;
+            size_t size;
+            if (cass_value_get_bytes(query_values.get_column(vals_index), &data, &size) != CASS_OK) {
+                throw std::runtime_error("Decode error");
+            }
+            decode_csr_chunk(data, size, std::max<size_t>(row_begin, chunk_begin) - chunk_begin,
+                             row_end - chunk_begin, i, values);
         }
         return values;
     }
 
+    typename csr_row_cache<T>::row_ptr get_cached_row(csr_row_cache<T>& cache, int i, int matrix_id) {
+        auto row = cache.find({matrix_id, i});
+        if (!row) {
+            row = cache.insert({matrix_id, i}, get_row(i, matrix_id, execution_profile::hot_read));
+        }
+        return row;
+    }
+
+    /* Pre-pass over the columns of the first matrix: every value in column j is a future use of row j
+     * of the second one. The uses seed the cache frequencies, and the most used rows are pinned
+     * within half of the cache budget.
+     */
+    void plan_row_cache(csr_row_cache<T>& cache, size_t first_id, size_t second_id,
+                        const csr_row_index& second_index) {
+        const csr_row_index& first_index = get_row_index(first_id, execution_profile::hot_read);
+
+        std::unordered_map<size_t, size_t> uses;
+        size_t last_bucket = 0;
+        for (size_t k = 0; k + 1 < first_index.stored_rows(); k++) {
+            size_t bucket = (first_index.row(k) - 1) / _bucket_rows;
+            if (k > 0 && bucket == last_bucket) continue;
+            last_bucket = bucket;
+            if (first_index.row_begin(bucket * _bucket_rows + 1) == first_index.row_begin((bucket + 1) * _bucket_rows + 1)) {
+                continue;
+            }
+
+            requestor query_columns(_conn, _select_bucket_query);
+            query_columns.set_profile(execution_profile::hot_read);
+            query_columns.bind((int32_t)first_id, (int32_t)bucket);
+            query_columns.send();
+            while (query_columns.next_row()) {
+                const cass_byte_t* data;
+                size_t size;
+                if (cass_value_get_bytes(query_columns.get_column((size_t)0), &data, &size) != CASS_OK) {
+                    throw std::runtime_error("Decode error");
+                }
+                for_each_csr_chunk_column<T>(data, size, [&uses, this](size_t column) {
+                    if (column >= 1 && column <= _dimension) {
+                        uses[column]++;
+                    }
+                });
+            }
+        }
+
+        std::vector<std::pair<size_t, size_t>> rows;
+        for (auto [row, row_uses] : uses) {
+            cache.expect_uses({second_id, row}, row_uses);
+            if (row_uses > 1) {
+                rows.emplace_back(row_uses, row);
+            }
+        }
+
+        std::sort(rows.begin(), rows.end(), std::greater<>());
+        size_t pinned_bytes = 0;
+        for (auto [row_uses, row] : rows) {
+            auto [row_begin, row_end] = second_index.row_range(row);
+            size_t bytes = sizeof(typename csr_row_cache<T>::row_t) + (row_end - row_begin) * sizeof(matrix_value<T>);
+            if (pinned_bytes + bytes > _row_cache_bytes / 2) continue;
+            pinned_bytes += bytes;
+            cache.pin({second_id, row});
+        }
+    }
+
 public:
-    CSR(std::shared_ptr<connector> conn) : _conn(conn), _matrix_id(0), _dimension(0) {
+    /* Memory budget of rows of the second matrix kept by multiply() */
+    static constexpr size_t default_row_cache_bytes = 64 << 20;
+
+    /* With pin_hot_rows, multiply() first counts the uses of every row of the second matrix
+     * and keeps the most used ones cached for the whole run.
+     * With hypersparse, matrices are stored doubly compressed (DCSR): only nonempty rows get row pointers,
+     * and multiply() visits only the nonempty rows of the first matrix, so both scale with the number
+     * of values rather than with the dimension.
+     */
+    CSR(std::shared_ptr<connector> conn, size_t max_in_flight = async_executor::default_max_in_flight,
+        size_t batch_size = batch_writer::default_batch_size, size_t row_cache_bytes = default_row_cache_bytes,
+        bool pin_hot_rows = true, bool hypersparse = false)
+            : _conn(conn), _writer(conn, max_in_flight), _row_batches(_writer, batch_size),
+              _row_cache_bytes(row_cache_bytes), _pin_hot_rows(pin_hot_rows), _hypersparse(hypersparse),
+              _matrix_id(0), _dimension(0) {
         /* Make sure that the necessary namespaces and table exist */
 
         requestor namespace_query(_conn);
@@ -74,11 +253,11 @@ public:
         requestor table_query_values(_conn);
         table_query_values << "CREATE TABLE " << _namespace << "." << _table_name_values << " ("
                        "    matrix_id int, "
-                       "    idx int, "
-                       "    column int, "
-                       "    value float, "
-                       "    PRIMARY KEY (matrix_id, idx) "
-                       ") WITH CLUSTERING ORDER BY (idx ASC);";
+                       "    bucket int, "
+                       "    chunk int, "
+                       "    vals blob, "
+                       "    PRIMARY KEY ((matrix_id, bucket), chunk) "
+                       ") WITH CLUSTERING ORDER BY (chunk ASC);";
         table_query_values.send();
 
         requestor table_query_rows(_conn);
@@ -100,69 +279,99 @@ public:
         _matrix_id++;
         size_t last_row = 0;
         size_t generated = 0;
-        while(gen.has_next()) {
-            auto mx_val = gen.next();
-            requestor query(_conn);
-            query << "INSERT INTO " << _namespace << "." << _table_name_values << " (matrix_id, idx, column, value) VALUES("
-                  << _matrix_id << ", " << generated << ", " << mx_val.j << ", " << mx_val.val << ");\n";
-            query.send();
-            while (last_row < mx_val.i) {
-                last_row++;
-                requestor query_rows(_conn);
-                query_rows << "INSERT INTO " << _namespace << "." << _table_name_rows << " (matrix_id, row, idx) VALUES("
-                           << _matrix_id << ", " << last_row << ", " << generated << ");\n";
-                query_rows.send();
+        chunk_builder chunks{_matrix_id, execution_profile::bulk_load};
+        std::vector<matrix_value<T>> batch;
+        batch.reserve(matrix_value_generator<T>::default_batch_size);
+
+        while (gen.next_batch(batch, matrix_value_generator<T>::default_batch_size) > 0) {
+            for (auto &mx_val : batch) {
+                append_value(chunks, mx_val);
+                if (_hypersparse) {
+                    if (last_row < mx_val.i) {
+                        last_row = mx_val.i;
+                        submit_row(_matrix_id, last_row, generated, execution_profile::bulk_load);
+                    }
+                } else {
+                    while (last_row < mx_val.i) {
+                        last_row++;
+                        submit_row(_matrix_id, last_row, generated, execution_profile::bulk_load);
+                    }
+                }
+                generated++;
             }
-            generated++;
+            batch.clear();
+        }
+        submit_chunk(chunks);
+        if (_hypersparse) {
+            last_row = _dimension;
         }
         while (last_row <= _dimension) {
             last_row++;
-            requestor query_rows(_conn);
-            query_rows << "INSERT INTO " << _namespace << "." << _table_name_rows << " (matrix_id, row, idx) VALUES("
-                       << _matrix_id << ", " << last_row << ", " << generated << ");\n";
-            query_rows.send();
+            submit_row(_matrix_id, last_row, generated, execution_profile::bulk_load);
         }
+        _row_batches.flush();
     }
 
-    /* Multiplies two matrices loaded into Scylla with load_matrix. */
+    /* Multiplies two matrices loaded into Scylla with load_matrix.
+     * Row pointers come from the in-memory row index, so every row read is a single range query.
+     * Result rows are accumulated row by row (Gustavson's algorithm); the accumulator of every row is chosen
+     * from its estimated size, the total length of the rows of B it combines.
+     * Rows of B are read through a row cache; its statistics are added to the query_stats counters.
+     */
     void multiply() {
         size_t first_id = _matrix_id - 1;
         size_t second_id = _matrix_id;
         int curr_elems = 0;
+        _row_indexes.erase(_result_id);
 
-        for (int row = 1; row <= _dimension; row++) {
-            std::map<int, matrix_value<T>> row_result;
-            requestor query_rows(_conn);
-            query_rows << "INSERT INTO " << _namespace << "." << _table_name_rows << " (matrix_id, row, idx) VALUES("
-                       << _result_id << ", " << row << ", " << curr_elems << ");\n";
-            query_rows.send();
-
-            std::vector<matrix_value<T>> row_first = get_row(row, first_id);
-            for (auto val_1 : row_first) {
-                std::vector<matrix_value<T>> row_second = get_row(val_1.j, second_id);
-                for (auto val_2 : row_second) {
-                    T added = val_1.val * val_2.val;
-                    if (row_result.count(val_2.j)) {
-                        auto & elem = row_result.at(val_2.j);
-                        elem.val += added;
-                    } else {
-                      row_result.insert( std::pair<int,matrix_value<T>>(val_2.j, matrix_value<T>(row, val_2.j, added)));
-                    }
+        const csr_row_index& first_index = get_row_index(first_id, execution_profile::hot_read);
+        const csr_row_index& second_index = get_row_index(second_id, execution_profile::hot_read);
+        csr_row_accumulator<T> accumulator(_dimension);
+        std::vector<matrix_value<T>> row_result;
+        chunk_builder result_chunks{_result_id, execution_profile::result_write};
+
+        csr_row_cache<T> row_cache(_row_cache_bytes);
+        if (_pin_hot_rows) {
+            plan_row_cache(row_cache, first_id, second_id, second_index);
+        }
+
+        /* Every row of a standard matrix is stored, only the nonempty ones of a hypersparse one */
+        for (size_t k = 0; k + 1 < first_index.stored_rows(); k++) {
+            size_t row = first_index.row(k);
+            std::vector<matrix_value<T>> row_first = get_row(row, first_id, execution_profile::hot_read);
+            size_t estimated_values = 0;
+            for (auto& val_1 : row_first) {
+                auto [row_begin, row_end] = second_index.row_range(val_1.j);
+                estimated_values += row_end - row_begin;
+            }
+
+            accumulator.begin_row(estimated_values);
+            for (auto& val_1 : row_first) {
+                auto row_second = get_cached_row(row_cache, val_1.j, second_id);
+                for (auto& val_2 : *row_second) {
+                    accumulator.add(val_2.j, val_1.val * val_2.val);
                 }
             }
-            for (auto elem_res : row_result) {
-                matrix_value<T> val_res = elem_res.second;
-                requestor query(_conn);
-                query << "INSERT INTO " << _namespace << "." << _table_name_values << " (matrix_id, idx, column, value) VALUES("
-                      << _result_id << ", " << curr_elems << ", " << val_res.j << ", " << val_res.val << ");\n";
-                query.send();
+
+            row_result.clear();
+            accumulator.extract(row, row_result);
+            if (!_hypersparse || !row_result.empty()) {
+                submit_row(_result_id, row, curr_elems, execution_profile::result_write);
+            }
+            for (auto& val_res : row_result) {
+                append_value(result_chunks, val_res);
                 curr_elems++;
             }
         }
-        requestor last_query_rows(_conn);
-        last_query_rows << "INSERT INTO " << _namespace << "." << _table_name_rows << " (matrix_id, row, idx) VALUES("
-                        << _result_id << ", " << _dimension+1 << ", " << curr_elems << ");\n";
-        last_query_rows.send();
+        submit_chunk(result_chunks);
+        submit_row(_result_id, _dimension + 1, curr_elems, execution_profile::result_write);
+        _row_batches.flush();
+
+        uint64_t hits = query_stats::counter("csr_row_cache_hits") += row_cache.hits();
+        uint64_t misses = query_stats::counter("csr_row_cache_misses") += row_cache.misses();
+        query_stats::set_value("csr_row_cache_hit_rate", hits + misses == 0 ? 0.0 : double(hits) / (hits + misses));
+        query_stats::counter("csr_row_cache_bytes_saved") += row_cache.bytes_saved();
+        query_stats::counter("csr_row_cache_pinned_rows") += row_cache.pinned();
     }
 
     /* Obtains the value in the multiplication result at (x; y) = (pos.first; pos.second) */
@@ -0,0 +1,309 @@
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "csr_row_accumulator.hh"
+#include "csr_row_cache.hh"
+#include "csr_row_index.hh"
+#include "csr_value_chunk.hh"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE csr_components_test
+#include <boost/test/unit_test.hpp>
+
+using row_t = std::vector<matrix_value<float>>;
+
+/* Values with deltas of every varint length, crossing several checkpoints */
+std::vector<uint64_t> delta_values(size_t count) {
+    std::vector<uint64_t> values;
+    uint64_t value = 5;
+    for (size_t k = 0; k < count; k++) {
+        values.push_back(value);
+        value += (k % 7 == 0) ? 0 : (k % 11 == 0) ? (uint64_t(1) << 40) : (k % 5 == 0) ? 300 : 1;
+    }
+    return values;
+}
+
+row_t single_value_row(size_t row) {
+    return {matrix_value<float>(row, 1, 1.0f)};
+}
+
+size_t single_value_row_bytes() {
+    return sizeof(row_t) + sizeof(matrix_value<float>);
+}
+
+BOOST_AUTO_TEST_SUITE(delta_sequence_test)
+    BOOST_AUTO_TEST_CASE(test_values_across_checkpoints) {
+        std::vector<uint64_t> values = delta_values(200);
+        delta_sequence sequence;
+        for (uint64_t value : values) {
+            sequence.push_back(value);
+        }
+
+        BOOST_TEST(sequence.size() == values.size());
+        for (size_t k = 0; k < values.size(); k++) {
+            BOOST_TEST(sequence[k] == values[k]);
+        }
+        for (size_t k : {62, 63, 64, 65, 127, 128, 198}) {
+            BOOST_TEST(sequence.pair_at(k).first == values[k]);
+            BOOST_TEST(sequence.pair_at(k).second == values[k + 1]);
+        }
+        BOOST_TEST(sequence.pair_at(199).first == values[199]);
+        BOOST_TEST(sequence.pair_at(199).second == values[199]);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_lower_bound) {
+        std::vector<uint64_t> values = delta_values(200);
+        delta_sequence sequence;
+        for (uint64_t value : values) {
+            sequence.push_back(value);
+        }
+
+        BOOST_TEST(sequence.lower_bound(0) == 0);
+        BOOST_TEST(sequence.lower_bound(values.back() + 1) == values.size());
+        for (uint64_t probe : {values[0], values[63], values[64], values[65], values[128] + 1, values[199]}) {
+            size_t expected = std::lower_bound(values.begin(), values.end(), probe) - values.begin();
+            BOOST_TEST(sequence.lower_bound(probe) == expected);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(test_empty) {
+        delta_sequence sequence;
+        BOOST_TEST(sequence.size() == 0);
+        BOOST_TEST(sequence.lower_bound(1) == 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_decreasing_value) {
+        delta_sequence sequence;
+        sequence.push_back(10);
+        BOOST_CHECK_THROW(sequence.push_back(9), std::runtime_error);
+    }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(csr_row_index_test)
+    BOOST_AUTO_TEST_CASE(test_standard) {
+        /* Rows 1..100, row r has r % 3 values; the closing pointer is stored under row 101 */
+        csr_row_index index;
+        std::vector<uint64_t> pointers(1, 0);
+        for (size_t row = 1; row <= 100; row++) {
+            index.push_back(row, pointers.back());
+            pointers.push_back(pointers.back() + row % 3);
+        }
+        index.push_back(101, pointers.back());
+
+        BOOST_TEST(!index.hypersparse());
+        BOOST_TEST(index.stored_rows() == 101);
+        for (size_t row = 1; row <= 100; row++) {
+            auto [begin, end] = index.row_range(row);
+            BOOST_TEST(begin == pointers[row - 1]);
+            BOOST_TEST(end == pointers[row]);
+        }
+        BOOST_TEST(index.row_range(0).first == index.row_range(0).second);
+        BOOST_TEST(index.row_range(101).first == index.row_range(101).second);
+        BOOST_TEST(index.row_begin(65) == pointers[64]);
+        BOOST_TEST(index.row_begin(500) == pointers.back());
+    }
+
+    BOOST_AUTO_TEST_CASE(test_missing_row) {
+        csr_row_index index;
+        index.push_back(1, 0);
+        BOOST_CHECK_THROW(index.push_back(3, 1), std::runtime_error);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_hypersparse) {
+        /* Nonempty rows 3, 6, ..., 600 with two values each, closed under row 1001 */
+        csr_row_index index(true);
+        for (size_t k = 1; k <= 200; k++) {
+            index.push_back(3 * k, 2 * (k - 1));
+        }
+        index.push_back(1001, 400);
+
+        BOOST_TEST(index.hypersparse());
+        BOOST_TEST(index.stored_rows() == 201);
+        for (size_t k : {1, 63, 64, 65, 129, 200}) {
+            auto [begin, end] = index.row_range(3 * k);
+            BOOST_TEST(begin == 2 * (k - 1));
+            BOOST_TEST(end == 2 * k);
+            BOOST_TEST(index.row(k - 1) == 3 * k);
+        }
+        for (size_t row : {1, 2, 193, 194, 601, 1001, 5000}) {
+            auto [begin, end] = index.row_range(row);
+            BOOST_TEST(begin == end);
+        }
+
+        /* Empty rows start where the next nonempty one does */
+        BOOST_TEST(index.row_begin(1) == 0);
+        BOOST_TEST(index.row_begin(193) == 2 * 64);
+        BOOST_TEST(index.row_begin(194) == 2 * 64);
+        BOOST_TEST(index.row_begin(601) == 400);
+        BOOST_TEST(index.row_begin(5000) == 400);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_hypersparse_rows_out_of_order) {
+        csr_row_index index(true);
+        index.push_back(5, 0);
+        BOOST_CHECK_THROW(index.push_back(5, 1), std::runtime_error);
+    }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(csr_row_accumulator_test)
+    BOOST_AUTO_TEST_CASE(test_hash_rehash_within_row) {
+        /* Estimated at one value, so the table grows several times while the row is accumulated */
+        csr_row_accumulator<float> accumulator(100000);
+        accumulator.begin_row(1);
+        for (size_t round = 0; round < 2; round++) {
+            for (size_t column = 1; column <= 100; column++) {
+                accumulator.add(column * 997, 1.0f);
+            }
+        }
+
+        row_t out;
+        accumulator.extract(7, out);
+        BOOST_TEST(out.size() == 100);
+        for (size_t k = 0; k < out.size(); k++) {
+            BOOST_TEST(out[k].i == 7);
+            BOOST_TEST(out[k].j == (k + 1) * 997);
+            BOOST_TEST(out[k].val == 2.0f);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(test_dense_then_hash) {
+        csr_row_accumulator<float> accumulator(64);
+
+        accumulator.begin_row(64);
+        for (size_t column : {64, 1, 32, 1}) {
+            accumulator.add(column, 1.5f);
+        }
+        row_t out;
+        accumulator.extract(1, out);
+        BOOST_TEST(out.size() == 3);
+        BOOST_TEST(out[0].j == 1);
+        BOOST_TEST(out[0].val == 3.0f);
+        BOOST_TEST(out[1].j == 32);
+        BOOST_TEST(out[2].j == 64);
+
+        /* Nothing of the previous row is left behind, whichever mode is used next */
+        accumulator.begin_row(1);
+        accumulator.add(32, 2.0f);
+        out.clear();
+        accumulator.extract(2, out);
+        BOOST_TEST(out.size() == 1);
+        BOOST_TEST(out[0].j == 32);
+        BOOST_TEST(out[0].val == 2.0f);
+
+        accumulator.begin_row(64);
+        out.clear();
+        accumulator.extract(3, out);
+        BOOST_TEST(out.empty());
+    }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(csr_row_cache_test)
+    BOOST_AUTO_TEST_CASE(test_tied_frequency_evicts_oldest) {
+        csr_row_cache<float> cache(2 * single_value_row_bytes());
+        for (size_t row : {1, 2, 3}) {
+            BOOST_TEST(cache.find({1, row}) == nullptr);
+            cache.insert({1, row}, single_value_row(row));
+        }
+
+        /* Row 3 was as frequent as rows 1 and 2, so it replaced the oldest one */
+        BOOST_TEST(cache.find({1, 1}) == nullptr);
+        BOOST_TEST(cache.find({1, 2}) != nullptr);
+        BOOST_TEST(cache.find({1, 3}) != nullptr);
+        BOOST_TEST(cache.hits() == 2);
+        BOOST_TEST(cache.misses() == 4);
+        BOOST_TEST(cache.bytes_saved() == 2 * single_value_row_bytes());
+    }
+
+    BOOST_AUTO_TEST_CASE(test_rare_row_not_admitted) {
+        csr_row_cache<float> cache(2 * single_value_row_bytes());
+        for (size_t row : {1, 2}) {
+            cache.find({1, row});
+            cache.insert({1, row}, single_value_row(row));
+            cache.find({1, row});
+        }
+
+        cache.find({1, 3});
+        auto row = cache.insert({1, 3}, single_value_row(3));
+        BOOST_TEST(row->size() == 1);
+        BOOST_TEST(cache.find({1, 1}) != nullptr);
+        BOOST_TEST(cache.find({1, 2}) != nullptr);
+        BOOST_TEST(cache.find({1, 3}) == nullptr);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_expected_uses) {
+        csr_row_cache<float> cache(single_value_row_bytes());
+        cache.expect_uses({1, 1}, 10);
+        cache.find({1, 1});
+        cache.insert({1, 1}, single_value_row(1));
+
+        /* Row 2 is used three times but row 1 is expected to be used more often */
+        for (size_t k = 0; k < 3; k++) {
+            cache.find({1, 2});
+            cache.insert({1, 2}, single_value_row(2));
+        }
+        BOOST_TEST(cache.find({1, 1}) != nullptr);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_pinned_rows) {
+        csr_row_cache<float> cache(single_value_row_bytes());
+        cache.pin({1, 1});
+        cache.pin({1, 2});
+        for (size_t row : {1, 2}) {
+            cache.find({1, row});
+            cache.insert({1, row}, single_value_row(row));
+        }
+        for (size_t k = 0; k < 5; k++) {
+            cache.find({1, 3});
+            cache.insert({1, 3}, single_value_row(3));
+        }
+
+        /* Pinned rows are kept over the budget and never evicted */
+        BOOST_TEST(cache.pinned() == 2);
+        BOOST_TEST(cache.find({1, 1}) != nullptr);
+        BOOST_TEST(cache.find({1, 2}) != nullptr);
+        BOOST_TEST(cache.find({1, 3}) == nullptr);
+    }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(csr_value_chunk_test)
+    BOOST_AUTO_TEST_CASE(test_round_trip) {
+        row_t chunk = {matrix_value<float>(1, 3, 1.5f), matrix_value<float>(1, 70000, -2.0f),
+                       matrix_value<float>(2, 1, 4.25f)};
+        std::vector<uint8_t> encoded;
+        encode_csr_chunk(chunk, encoded);
+        BOOST_TEST(encoded.size() == csr_chunk_encoded_size(3, sizeof(float)));
+        BOOST_TEST(csr_chunk_count<float>(encoded.data(), encoded.size()) == 3);
+
+        /* Rows are not stored, the caller passes them */
+        row_t out;
+        decode_csr_chunk<float>(encoded.data(), encoded.size(), 1, 10, 9, out);
+        BOOST_TEST(out.size() == 2);
+        BOOST_TEST(out[0].i == 9);
+        BOOST_TEST(out[0].j == 70000);
+        BOOST_TEST(out[0].val == -2.0f);
+        BOOST_TEST(out[1].j == 1);
+        BOOST_TEST(out[1].val == 4.25f);
+
+        std::vector<size_t> columns;
+        for_each_csr_chunk_column<float>(encoded.data(), encoded.size(), [&](uint32_t column) {
+            columns.push_back(column);
+        });
+        BOOST_TEST(columns == std::vector<size_t>({3, 70000, 1}));
+    }
+
+    BOOST_AUTO_TEST_CASE(test_empty_chunk) {
+        std::vector<uint8_t> encoded;
+        encode_csr_chunk(row_t(), encoded);
+        BOOST_TEST(csr_chunk_count<float>(encoded.data(), encoded.size()) == 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_malformed_chunks) {
+        std::vector<uint8_t> encoded;
+        encode_csr_chunk(row_t{matrix_value<float>(1, 1, 1.0f)}, encoded);
+
+        BOOST_CHECK_THROW(csr_chunk_count<float>(encoded.data(), 4), std::runtime_error);
+        BOOST_CHECK_THROW(csr_chunk_count<float>(encoded.data(), encoded.size() - 1), std::runtime_error);
+        BOOST_CHECK_THROW(csr_chunk_count<double>(encoded.data(), encoded.size()), std::runtime_error);
+    }
+BOOST_AUTO_TEST_SUITE_END()
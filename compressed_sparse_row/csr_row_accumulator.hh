@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "../matrix_value.hh"
+
+/* Sparse accumulator of one result row of a row-by-row (Gustavson) sparse product.
+ *
+ * Every row is accumulated either in a dense array indexed by column, with a list of touched columns,
+ * or in an open-addressing hash table, depending on the estimated number of its values: a dense
+ * array pays off once a noticeable fraction of the columns is hit, a hash table keeps sparse rows
+ * cache-friendly. Buffers are kept between rows, and extract() clears only the touched entries.
+ */
+template <class T>
+class csr_row_accumulator {
+    /* Rows estimated to fill at least 1/dense_ratio of the columns use the dense array */
+    static constexpr size_t dense_ratio = 16;
+
+    size_t _columns;
+    bool _dense;
+
+    std::vector<T> _dense_values;
+    std::vector<uint8_t> _dense_used;
+    std::vector<size_t> _touched;
+
+    /* Hash table keyed by column; columns are counted from 1, so 0 marks a free slot */
+    std::vector<size_t> _hash_columns;
+    std::vector<T> _hash_values;
+    size_t _hash_mask;
+    size_t _hash_size;
+
+    std::vector<std::pair<size_t, T>> _sorted;
+
+    static size_t hash(size_t column) {
+        return column * 0x9e3779b97f4a7c15ULL >> 17;
+    }
+
+    void resize_hash(size_t capacity) {
+        std::vector<size_t> old_columns(capacity, 0);
+        std::vector<T> old_values(capacity, 0);
+        old_columns.swap(_hash_columns);
+        old_values.swap(_hash_values);
+        _hash_mask = capacity - 1;
+        _hash_size = 0;
+        _touched.clear();
+
+        for (size_t slot = 0; slot < old_columns.size(); slot++) {
+            if (old_columns[slot] != 0) {
+                add(old_columns[slot], old_values[slot]);
+            }
+        }
+    }
+
+public:
+    explicit csr_row_accumulator(size_t columns)
+            : _columns(columns), _dense(false), _hash_mask(0), _hash_size(0) {}
+
+    /* Starts a row expected to have at most estimated_values values. */
+    void begin_row(size_t estimated_values) {
+        estimated_values = std::min(estimated_values, _columns);
+        _dense = estimated_values * dense_ratio >= _columns;
+
+        if (_dense) {
+            if (_dense_values.empty()) {
+                _dense_values.assign(_columns + 1, 0);
+                _dense_used.assign(_columns + 1, 0);
+            }
+        } else {
+            /* Kept at most half full */
+            size_t capacity = 16;
+            while (capacity < 2 * estimated_values) {
+                capacity *= 2;
+            }
+            if (_hash_columns.size() < capacity) {
+                resize_hash(capacity);
+            }
+        }
+    }
+
+    void add(size_t column, T value) {
+        if (_dense) {
+            if (!_dense_used[column]) {
+                _dense_used[column] = 1;
+                _touched.push_back(column);
+            }
+            _dense_values[column] += value;
+            return;
+        }
+
+        size_t slot = hash(column) & _hash_mask;
+        while (_hash_columns[slot] != column) {
+            if (_hash_columns[slot] == 0) {
+                if (2 * (_hash_size + 1) > _hash_columns.size()) {
+                    resize_hash(2 * _hash_columns.size());
+                    add(column, value);
+                    return;
+                }
+                _hash_columns[slot] = column;
+                _touched.push_back(slot);
+                _hash_size++;
+                break;
+            }
+            slot = (slot + 1) & _hash_mask;
+        }
+        _hash_values[slot] += value;
+    }
+
+    /* Appends the accumulated values of the row to out, ordered by column, and clears the accumulator. */
+    void extract(size_t row, std::vector<matrix_value<T>>& out) {
+        if (_dense) {
+            std::sort(_touched.begin(), _touched.end());
+            for (size_t column : _touched) {
+                out.emplace_back(row, column, _dense_values[column]);
+                _dense_values[column] = 0;
+                _dense_used[column] = 0;
+            }
+        } else {
+            _sorted.clear();
+            for (size_t slot : _touched) {
+                _sorted.emplace_back(_hash_columns[slot], _hash_values[slot]);
+                _hash_columns[slot] = 0;
+                _hash_values[slot] = 0;
+            }
+            _hash_size = 0;
+            std::sort(_sorted.begin(), _sorted.end(), [](auto& a, auto& b) {
+                return a.first < b.first;
+            });
+            for (auto& [column, value] : _sorted) {
+                out.emplace_back(row, column, value);
+            }
+        }
+        _touched.clear();
+    }
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "../matrix_value.hh"
+
+/* Cache of fetched CSR rows with a byte budget and least-frequently-used eviction.
+ *
+ * Frequencies are counted for every requested row, cached or not, and a fetched row is only admitted
+ * if it is used at least as often as the rows it would evict, so one-off rows do not flush popular ones.
+ * Rows known in advance to be hot can be pinned: they are always admitted and never evicted.
+ * Frequencies can also be seeded with expected numbers of uses.
+ */
+template <class T>
+class csr_row_cache {
+public:
+    using row_t = std::vector<matrix_value<T>>;
+    using row_ptr = std::shared_ptr<const row_t>;
+    /* (matrix id, row) */
+    using key_t = std::pair<size_t, size_t>;
+
+private:
+    struct entry {
+        row_ptr row;
+        size_t bytes;
+        /* Insertion order, breaking frequency ties towards the oldest row */
+        uint64_t tick;
+    };
+
+    size_t _byte_budget;
+    size_t _used_bytes;
+    uint64_t _ticks;
+    std::map<key_t, size_t> _frequency;
+    std::set<key_t> _pinned;
+    std::map<key_t, entry> _entries;
+    /* (frequency, tick, key) of the cached rows which are not pinned, the next victim first */
+    std::set<std::tuple<size_t, uint64_t, key_t>> _eviction_order;
+    size_t _hits, _misses, _bytes_saved;
+
+    static size_t row_bytes(const row_t& row) {
+        return sizeof(row_t) + row.size() * sizeof(matrix_value<T>);
+    }
+
+public:
+    explicit csr_row_cache(size_t byte_budget)
+            : _byte_budget(byte_budget), _used_bytes(0), _ticks(0), _hits(0), _misses(0), _bytes_saved(0) {}
+
+    /* Adds expected uses of a row to its frequency. */
+    void expect_uses(const key_t& key, size_t uses) {
+        _frequency[key] += uses;
+    }
+
+    /* Keeps the row once it is inserted, regardless of the budget. */
+    void pin(const key_t& key) {
+        _pinned.insert(key);
+    }
+
+    /* Returns the cached row, or nullptr if the caller has to fetch (and then insert) it. */
+    row_ptr find(const key_t& key) {
+        size_t& frequency = _frequency[key];
+        auto it = _entries.find(key);
+        if (it == _entries.end()) {
+            frequency++;
+            _misses++;
+            return nullptr;
+        }
+
+        if (_pinned.count(key) == 0) {
+            _eviction_order.erase({frequency, it->second.tick, key});
+            _eviction_order.emplace(frequency + 1, it->second.tick, key);
+        }
+        frequency++;
+        _hits++;
+        _bytes_saved += it->second.bytes;
+        return it->second.row;
+    }
+
+    /* Caches a fetched row, evicting less frequently used rows if necessary. */
+    row_ptr insert(const key_t& key, row_t&& row) {
+        auto ptr = std::make_shared<const row_t>(std::move(row));
+        if (_entries.count(key) != 0) {
+            return ptr;
+        }
+
+        size_t bytes = row_bytes(*ptr);
+        size_t frequency = _frequency[key];
+        bool pinned = _pinned.count(key) != 0;
+        if (!pinned) {
+            while (_used_bytes + bytes > _byte_budget) {
+                if (_eviction_order.empty() || std::get<0>(*_eviction_order.begin()) > frequency) {
+                    return ptr;
+                }
+                auto victim = _entries.find(std::get<2>(*_eviction_order.begin()));
+                _used_bytes -= victim->second.bytes;
+                _entries.erase(victim);
+                _eviction_order.erase(_eviction_order.begin());
+            }
+            _eviction_order.emplace(frequency, _ticks, key);
+        }
+
+        _entries.emplace(key, entry{ptr, bytes, _ticks++});
+        _used_bytes += bytes;
+        return ptr;
+    }
+
+    /* Number of find() calls served from the cache, and returning nullptr */
+    size_t hits() const {
+        return _hits;
+    }
+
+    size_t misses() const {
+        return _misses;
+    }
+
+    /* Total size of the rows served from the cache, i.e. not fetched again */
+    size_t bytes_saved() const {
+        return _bytes_saved;
+    }
+
+    size_t pinned() const {
+        return _pinned.size();
+    }
+};
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/* Non-decreasing sequence of integers stored as LEB128 varint deltas (one byte for deltas below 128),
+ * with an absolute checkpoint every checkpoint_interval values. A lookup decodes at most
+ * checkpoint_interval deltas.
+ */
+class delta_sequence {
+    static constexpr size_t checkpoint_interval = 64;
+
+    struct checkpoint {
+        uint64_t value;
+        /* Position of the delta following the checkpointed value */
+        size_t position;
+    };
+
+    std::vector<checkpoint> _checkpoints;
+    std::vector<uint8_t> _deltas;
+    size_t _size = 0;
+    uint64_t _last = 0;
+
+    static uint64_t read_delta(const uint8_t*& pos) {
+        uint64_t delta = 0;
+        for (unsigned shift = 0;; shift += 7) {
+            uint8_t byte = *pos++;
+            delta |= uint64_t(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) return delta;
+        }
+    }
+
+public:
+    void push_back(uint64_t value) {
+        if (_size > 0 && value < _last) {
+            throw std::runtime_error("Decreasing value in a delta sequence");
+        }
+
+        if (_size % checkpoint_interval == 0) {
+            _checkpoints.push_back({value, _deltas.size()});
+        } else {
+            uint64_t delta = value - _last;
+            while (delta >= 0x80) {
+                _deltas.push_back(uint8_t(delta) | 0x80);
+                delta >>= 7;
+            }
+            _deltas.push_back(uint8_t(delta));
+        }
+        _last = value;
+        _size++;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    uint64_t operator[](size_t k) const {
+        return pair_at(k).first;
+    }
+
+    /* (value k, value k + 1), or (value k, value k) for the last value */
+    std::pair<uint64_t, uint64_t> pair_at(size_t k) const {
+        const checkpoint& from = _checkpoints[k / checkpoint_interval];
+        const uint8_t* pos = _deltas.data() + from.position;
+
+        uint64_t value = from.value;
+        for (size_t skipped = k % checkpoint_interval; skipped > 0; skipped--) {
+            value += read_delta(pos);
+        }
+        if (k + 1 >= _size) {
+            return {value, value};
+        }
+        uint64_t next = (k + 1) % checkpoint_interval == 0 ? _checkpoints[(k + 1) / checkpoint_interval].value
+                                                           : value + read_delta(pos);
+        return {value, next};
+    }
+
+    /* Position of the first value not less than the given one, or size() if there is none */
+    size_t lower_bound(uint64_t value) const {
+        /* The first such value follows the last checkpoint below it */
+        auto not_less = std::lower_bound(_checkpoints.begin(), _checkpoints.end(), value,
+                                         [](const checkpoint& c, uint64_t v) { return c.value < v; });
+        if (not_less == _checkpoints.begin()) {
+            return 0;
+        }
+        size_t group = not_less - _checkpoints.begin() - 1;
+        size_t k = group * checkpoint_interval;
+
+        const uint8_t* pos = _deltas.data() + _checkpoints[group].position;
+        uint64_t current = _checkpoints[group].value;
+        while (current < value) {
+            k++;
+            if (k >= _size) return _size;
+            if (k % checkpoint_interval == 0) {
+                current = _checkpoints[k / checkpoint_interval].value;
+                pos = _deltas.data() + _checkpoints[k / checkpoint_interval].position;
+            } else {
+                current += read_delta(pos);
+            }
+        }
+        return k;
+    }
+
+    /* Approximate memory use in bytes */
+    size_t bytes() const {
+        return _deltas.capacity() + _checkpoints.capacity() * sizeof(checkpoint);
+    }
+};
+
+/* In-memory row pointers of a CSR matrix: the index of the first value of every stored row,
+ * followed by a pointer one past the last value, stored under row number rows + 1.
+ *
+ * A standard index stores every row. A hypersparse (doubly compressed, DCSR) index stores only
+ * the nonempty rows, with their numbers kept in a second delta sequence, so its size depends
+ * on the number of nonempty rows and not on the dimension.
+ */
+class csr_row_index {
+    bool _hypersparse;
+    delta_sequence _pointers;
+    /* Numbers of the stored rows, kept only by hypersparse indexes */
+    delta_sequence _rows;
+
+    /* Position of the first stored row not less than the given one */
+    size_t position_of(uint64_t row) const {
+        if (!_hypersparse) {
+            return std::min<uint64_t>(row - 1, _pointers.size());
+        }
+        return _rows.lower_bound(row);
+    }
+
+public:
+    explicit csr_row_index(bool hypersparse = false) : _hypersparse(hypersparse) {}
+
+    bool hypersparse() const {
+        return _hypersparse;
+    }
+
+    /* Appends the pointer of the given row. Rows have to be appended in increasing order,
+     * and without gaps unless the index is hypersparse.
+     */
+    void push_back(uint64_t row, uint64_t pointer) {
+        if (_hypersparse) {
+            if (_rows.size() > 0 && row <= _rows[_rows.size() - 1]) {
+                throw std::runtime_error("CSR rows out of order");
+            }
+            _rows.push_back(row);
+        } else if (row != _pointers.size() + 1) {
+            throw std::runtime_error("Missing CSR row pointer");
+        }
+        _pointers.push_back(pointer);
+    }
+
+    /* Number of stored rows, including the closing one */
+    size_t stored_rows() const {
+        return _pointers.size();
+    }
+
+    /* Number of the k-th stored row */
+    uint64_t row(size_t k) const {
+        return _hypersparse ? _rows[k] : k + 1;
+    }
+
+    /* [begin, end) of the values of a row, empty if it is not stored */
+    std::pair<uint64_t, uint64_t> row_range(uint64_t row) const {
+        if (row < 1) {
+            return {0, 0};
+        }
+        size_t k = position_of(row);
+        if (k + 1 >= _pointers.size() || this->row(k) != row) {
+            return {0, 0};
+        }
+        return _pointers.pair_at(k);
+    }
+
+    /* Index of the first value in the rows from the given one on */
+    uint64_t row_begin(uint64_t row) const {
+        size_t k = position_of(std::max<uint64_t>(row, 1));
+        return k < _pointers.size() ? _pointers[k] : _pointers[_pointers.size() - 1];
+    }
+
+    /* Approximate memory use in bytes */
+    size_t bytes() const {
+        return _pointers.bytes() + _rows.bytes();
+    }
+};
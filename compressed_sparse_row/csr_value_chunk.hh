@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "../matrix_value.hh"
+
+/* Packed blob encoding of a chunk of consecutive values of a CSR matrix.
+ *
+ * Layout (host byte order):
+ *  - csr_chunk_header,
+ *  - count uint32 columns,
+ *  - count raw values of value_size bytes.
+ * Rows are not stored; they follow from the row pointers.
+ */
+struct csr_chunk_header {
+    uint32_t count;
+    uint32_t value_size;
+};
+
+inline size_t csr_chunk_encoded_size(size_t count, size_t value_size) {
+    return sizeof(csr_chunk_header) + count * (sizeof(uint32_t) + value_size);
+}
+
+/* Replaces the contents of out with the encoded columns and values of the chunk. */
+template <class T>
+void encode_csr_chunk(const std::vector<matrix_value<T>>& chunk, std::vector<uint8_t>& out) {
+    csr_chunk_header header{};
+    header.count = chunk.size();
+    header.value_size = sizeof(T);
+
+    out.resize(csr_chunk_encoded_size(chunk.size(), sizeof(T)));
+    uint8_t* columns = out.data() + sizeof(csr_chunk_header);
+    uint8_t* values = columns + chunk.size() * sizeof(uint32_t);
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    for (size_t k = 0; k < chunk.size(); k++) {
+        uint32_t column = chunk[k].j;
+        std::memcpy(columns + k * sizeof(uint32_t), &column, sizeof(uint32_t));
+        std::memcpy(values + k * sizeof(T), &chunk[k].val, sizeof(T));
+    }
+}
+
+/* Number of values in an encoded chunk, checking that the blob is well-formed. */
+template <class T>
+size_t csr_chunk_count(const uint8_t* data, size_t size) {
+    csr_chunk_header header;
+    if (size < sizeof(header)) {
+        throw std::runtime_error("Truncated CSR chunk");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.value_size != sizeof(T) || size != csr_chunk_encoded_size(header.count, sizeof(T))) {
+        throw std::runtime_error("Malformed CSR chunk");
+    }
+    return header.count;
+}
+
+/* Appends the values at positions [first, last) of an encoded chunk to out, as values of the given row. */
+template <class T>
+void decode_csr_chunk(const uint8_t* data, size_t size, size_t first, size_t last, size_t row,
+                      std::vector<matrix_value<T>>& out) {
+    size_t count = csr_chunk_count<T>(data, size);
+    last = std::min(last, count);
+
+    const uint8_t* columns = data + sizeof(csr_chunk_header);
+    const uint8_t* values = columns + count * sizeof(uint32_t);
+    for (size_t k = first; k < last; k++) {
+        uint32_t column;
+        T val;
+        std::memcpy(&column, columns + k * sizeof(uint32_t), sizeof(uint32_t));
+        std::memcpy(&val, values + k * sizeof(T), sizeof(T));
+        out.emplace_back(row, column, val);
+    }
+}
+
+/* Calls f(column) for every value of an encoded chunk. */
+template <class T, class F>
+void for_each_csr_chunk_column(const uint8_t* data, size_t size, F&& f) {
+    size_t count = csr_chunk_count<T>(data, size);
+    const uint8_t* columns = data + sizeof(csr_chunk_header);
+    for (size_t k = 0; k < count; k++) {
+        uint32_t column;
+        std::memcpy(&column, columns + k * sizeof(uint32_t), sizeof(uint32_t));
+        f(column);
+    }
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+#include "../matrix_value.hh"
+
+/* Cache of fetched COO blocks with a byte budget.
+ *
+ * The owner knows its access schedule and passes a function returning the time of the next use
+ * of a block (never_used if there is none). When over budget, the block used furthest in the future
+ * is evicted first (Belady's policy), which includes not keeping a freshly fetched block at all.
+ * Blocks can be prefetched: the fetcher only starts an asynchronous read and returns a function waiting
+ * for it, so a prefetch takes no thread, and get() then waits for the pending read.
+ * Safe to share between threads; the next-use function is called with the cache locked.
+ *
+ * Cached blocks are kept ordered by their next use, as of when it was last computed. Next uses only
+ * move forward as the schedule progresses, so the stale ones are at the front of the order and are
+ * recomputed there before choosing a victim; the victim is then the last block of the order.
+ */
+template <class T>
+class coo_block_cache {
+public:
+    using block_t = std::vector<matrix_value<T>>;
+    using block_ptr = std::shared_ptr<const block_t>;
+    /* (matrix id, block id) */
+    using key_t = std::pair<size_t, size_t>;
+    /* Waits for a started fetch and returns the block */
+    using pending_fetch_t = std::function<block_t()>;
+    /* Starts fetching a block */
+    using fetcher_t = std::function<pending_fetch_t(size_t matrix_id, size_t block_id)>;
+    using next_use_t = std::function<size_t(const key_t& key)>;
+
+    static constexpr size_t never_used = std::numeric_limits<size_t>::max();
+
+private:
+    struct entry {
+        std::shared_future<block_ptr> block;
+        /* Zero until the fetch is complete and accounted for */
+        size_t bytes;
+        /* Key of the block in _eviction_order, valid once the fetch is accounted for */
+        size_t next_use;
+    };
+
+    size_t _byte_budget;
+    size_t _used_bytes;
+    fetcher_t _fetch;
+    next_use_t _next_use;
+    std::map<key_t, entry> _entries;
+    /* (next use, key) of the completed blocks, the next victim last */
+    std::set<std::pair<size_t, key_t>> _eviction_order;
+    size_t _hits, _misses;
+    std::mutex _mutex;
+
+    static size_t block_bytes(const block_t& block) {
+        return sizeof(block_t) + block.size() * sizeof(matrix_value<T>);
+    }
+
+    /* Starts reading the block right away; the first thread waiting for the result decodes it */
+    std::shared_future<block_ptr> start_fetch(const key_t& key) {
+        return std::async(std::launch::deferred, [pending = _fetch(key.first, key.second)] {
+            return std::make_shared<const block_t>(pending());
+        }).share();
+    }
+
+    /* Reads the block once the result is waited for */
+    std::shared_future<block_ptr> deferred_fetch(const key_t& key) {
+        return std::async(std::launch::deferred, [fetch = _fetch, key] {
+            return std::make_shared<const block_t>(fetch(key.first, key.second)());
+        }).share();
+    }
+
+    /* Recomputes next uses from the front of the order until the first block is up to date. */
+    void refresh_order() {
+        while (!_eviction_order.empty()) {
+            auto [use, key] = *_eviction_order.begin();
+            size_t next_use = _next_use(key);
+            if (next_use <= use) return;
+
+            _eviction_order.erase(_eviction_order.begin());
+            _eviction_order.emplace(next_use, key);
+            _entries.find(key)->second.next_use = next_use;
+        }
+    }
+
+    /* Evicts completed blocks used furthest in the future until the cache fits in its budget. */
+    void evict() {
+        if (_used_bytes <= _byte_budget) return;
+
+        refresh_order();
+        while (_used_bytes > _byte_budget && !_eviction_order.empty()) {
+            auto victim = _entries.find(std::prev(_eviction_order.end())->second);
+            _eviction_order.erase(std::prev(_eviction_order.end()));
+            _used_bytes -= victim->second.bytes;
+            _entries.erase(victim);
+        }
+    }
+
+public:
+    coo_block_cache(size_t byte_budget, fetcher_t fetch, next_use_t next_use)
+            : _byte_budget(byte_budget), _used_bytes(0), _fetch(std::move(fetch)), _next_use(std::move(next_use)),
+              _hits(0), _misses(0) {}
+
+    /* Starts fetching the block in the background, unless it is cached or being fetched. */
+    void prefetch(size_t matrix_id, size_t block_id) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        key_t key(matrix_id, block_id);
+        if (_entries.count(key) == 0 && _next_use(key) != never_used) {
+            _entries.emplace(key, entry{start_fetch(key), 0, 0});
+        }
+    }
+
+    /* Returns the block, fetching it if it is neither cached nor prefetched. */
+    block_ptr get(size_t matrix_id, size_t block_id) {
+        key_t key(matrix_id, block_id);
+        std::shared_future<block_ptr> pending;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _entries.find(key);
+            if (it == _entries.end()) {
+                _misses++;
+                it = _entries.emplace(key, entry{deferred_fetch(key), 0, 0}).first;
+            } else {
+                _hits++;
+            }
+            pending = it->second.block;
+        }
+
+        /* Waited for (or, when not prefetched, fetched) without holding the lock */
+        block_ptr block;
+        try {
+            block = pending.get();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _entries.erase(key);
+            throw;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _entries.find(key);
+        if (it != _entries.end() && it->second.bytes == 0) {
+            it->second.bytes = block_bytes(*block);
+            it->second.next_use = _next_use(key);
+            _eviction_order.emplace(it->second.next_use, key);
+            _used_bytes += it->second.bytes;
+            evict();
+        }
+        return block;
+    }
+
+    /* Number of get() calls served from the cache (or a prefetch), and fetched on demand */
+    size_t hits() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _hits;
+    }
+
+    size_t misses() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _misses;
+    }
+};
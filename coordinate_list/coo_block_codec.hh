@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include "../matrix_value.hh"
+
+/* Packed blob encoding of a COO block.
+ *
+ * Layout (host byte order):
+ *  - coo_block_header,
+ *  - count uint16 row deltas: difference to the row of the previous value (to row_origin for the first one),
+ *  - count uint16 column deltas: difference to the column of the previous value in the same row,
+ *    or to column_origin for the first value of a row,
+ *  - count raw values of value_size bytes.
+ * Values have to be sorted in row-major order, and a block may span at most 65536 rows and columns.
+ */
+struct coo_block_header {
+    uint32_t count;
+    uint32_t value_size;
+    uint64_t row_origin, column_origin;
+};
+
+inline size_t coo_block_encoded_size(size_t count, size_t value_size) {
+    return sizeof(coo_block_header) + count * (2 * sizeof(uint16_t) + value_size);
+}
+
+/* Replaces the contents of out with the encoded block. */
+template <class T>
+void encode_coo_block(const std::vector<matrix_value<T>>& block, std::vector<uint8_t>& out) {
+    coo_block_header header{};
+    header.count = block.size();
+    header.value_size = sizeof(T);
+    if (!block.empty()) {
+        header.row_origin = block.front().i;
+        header.column_origin = std::min_element(block.begin(), block.end(), [](auto& a, auto& b) {
+            return a.j < b.j;
+        })->j;
+    }
+
+    out.resize(coo_block_encoded_size(block.size(), sizeof(T)));
+    uint8_t* rows = out.data() + sizeof(coo_block_header);
+    uint8_t* columns = rows + block.size() * sizeof(uint16_t);
+    uint8_t* values = columns + block.size() * sizeof(uint16_t);
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    size_t last_row = header.row_origin, last_column = header.column_origin;
+    for (size_t k = 0; k < block.size(); k++) {
+        const auto& value = block[k];
+        if (value.i < last_row || (k > 0 && value.i == last_row && value.j <= last_column)) {
+            throw std::runtime_error("COO block values are not in row-major order");
+        }
+        if (k == 0 || value.i != last_row) {
+            last_column = header.column_origin;
+        }
+
+        size_t row_delta = value.i - last_row, column_delta = value.j - last_column;
+        if (row_delta > std::numeric_limits<uint16_t>::max() || column_delta > std::numeric_limits<uint16_t>::max()) {
+            throw std::runtime_error("COO block too large to encode");
+        }
+        uint16_t row_delta16 = row_delta, column_delta16 = column_delta;
+        std::memcpy(rows + k * sizeof(uint16_t), &row_delta16, sizeof(uint16_t));
+        std::memcpy(columns + k * sizeof(uint16_t), &column_delta16, sizeof(uint16_t));
+        std::memcpy(values + k * sizeof(T), &value.val, sizeof(T));
+
+        last_row = value.i;
+        last_column = value.j;
+    }
+}
+
+/* Appends the values of an encoded block to out, reading the blob in place. */
+template <class T>
+void decode_coo_block(const uint8_t* data, size_t size, std::vector<matrix_value<T>>& out) {
+    coo_block_header header;
+    if (size < sizeof(header)) {
+        throw std::runtime_error("Truncated COO block");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.value_size != sizeof(T) || size != coo_block_encoded_size(header.count, sizeof(T))) {
+        throw std::runtime_error("Malformed COO block");
+    }
+
+    const uint8_t* rows = data + sizeof(coo_block_header);
+    const uint8_t* columns = rows + header.count * sizeof(uint16_t);
+    const uint8_t* values = columns + header.count * sizeof(uint16_t);
+
+    out.reserve(out.size() + header.count);
+    size_t row = header.row_origin, column = header.column_origin;
+    for (size_t k = 0; k < header.count; k++) {
+        uint16_t row_delta, column_delta;
+        T val;
+        std::memcpy(&row_delta, rows + k * sizeof(uint16_t), sizeof(uint16_t));
+        std::memcpy(&column_delta, columns + k * sizeof(uint16_t), sizeof(uint16_t));
+        std::memcpy(&val, values + k * sizeof(T), sizeof(T));
+
+        if (k == 0 || row_delta != 0) {
+            column = header.column_origin;
+        }
+        row += row_delta;
+        column += column_delta;
+        out.emplace_back(row, column, val);
+    }
+}
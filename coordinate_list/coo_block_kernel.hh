@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "../matrix_value.hh"
+
+/* Scratchpad accumulating one result block of a blocked sparse product.
+ *
+ * Every block is accumulated either in a dense rows x columns array of sums with an occupancy bitmap,
+ * or in an open-addressing hash table keyed by cell, depending on the estimated number of its cells:
+ * the dense array makes adding a partial product an indexed add and a bit set, but costs memory and
+ * an extract scan proportional to the whole block, so sparse blocks use the hash table. The dense
+ * array is only allocated once a block needs it. Buffers are kept between blocks, and extract()
+ * clears only the touched entries.
+ */
+template <class T>
+class coo_block_accumulator {
+    /* Blocks estimated to fill at least 1/dense_ratio of the cells use the dense array */
+    static constexpr size_t dense_ratio = 16;
+
+    size_t _rows, _columns, _inner;
+    size_t _row_origin, _column_origin;
+    bool _dense;
+
+    std::vector<double> _sums;
+    std::vector<uint64_t> _occupied;
+
+    /* Hash table keyed by cell + 1, so 0 marks a free slot */
+    std::vector<size_t> _hash_cells;
+    std::vector<double> _hash_sums;
+    std::vector<size_t> _touched;
+    size_t _hash_mask;
+    size_t _hash_size;
+    std::vector<std::pair<size_t, double>> _sorted;
+
+    /* Offsets of the rows of the current B block, built by counting */
+    std::vector<uint32_t> _b_row_begin;
+
+    static size_t hash(size_t cell) {
+        return cell * 0x9e3779b97f4a7c15ULL >> 17;
+    }
+
+    void resize_hash(size_t capacity) {
+        std::vector<size_t> old_cells(capacity, 0);
+        std::vector<double> old_sums(capacity, 0.0);
+        old_cells.swap(_hash_cells);
+        old_sums.swap(_hash_sums);
+        _hash_mask = capacity - 1;
+        _hash_size = 0;
+        _touched.clear();
+
+        for (size_t slot = 0; slot < old_cells.size(); slot++) {
+            if (old_cells[slot] != 0) {
+                add(old_cells[slot] - 1, old_sums[slot]);
+            }
+        }
+    }
+
+    void add(size_t cell, double value) {
+        if (_dense) {
+            _sums[cell] += value;
+            _occupied[cell / 64] |= uint64_t(1) << (cell % 64);
+            return;
+        }
+
+        size_t slot = hash(cell) & _hash_mask;
+        while (_hash_cells[slot] != cell + 1) {
+            if (_hash_cells[slot] == 0) {
+                if (2 * (_hash_size + 1) > _hash_cells.size()) {
+                    resize_hash(2 * _hash_cells.size());
+                    add(cell, value);
+                    return;
+                }
+                _hash_cells[slot] = cell + 1;
+                _touched.push_back(slot);
+                _hash_size++;
+                break;
+            }
+            slot = (slot + 1) & _hash_mask;
+        }
+        _hash_sums[slot] += value;
+    }
+
+public:
+    /* Blocks of A are rows x inner, blocks of B inner x columns. */
+    coo_block_accumulator(size_t rows, size_t columns, size_t inner)
+            : _rows(rows), _columns(columns), _inner(inner), _row_origin(1), _column_origin(1), _dense(false),
+              _hash_mask(0), _hash_size(0), _b_row_begin(inner + 1) {}
+
+    /* Starts accumulating the result block whose first cell is (row_origin, column_origin),
+     * expected to have at most estimated_cells cells.
+     */
+    void reset(size_t row_origin, size_t column_origin, size_t estimated_cells) {
+        _row_origin = row_origin;
+        _column_origin = column_origin;
+
+        size_t cells = _rows * _columns;
+        estimated_cells = std::min(estimated_cells, cells);
+        _dense = estimated_cells * dense_ratio >= cells;
+
+        if (_dense) {
+            if (_sums.empty()) {
+                _sums.assign(cells, 0.0);
+                _occupied.assign((cells + 63) / 64, 0);
+            }
+        } else {
+            /* Kept at most half full */
+            size_t capacity = 16;
+            while (capacity < 2 * estimated_cells) {
+                capacity *= 2;
+            }
+            if (_hash_cells.size() < capacity) {
+                resize_hash(capacity);
+            }
+        }
+    }
+
+    /* Adds the product of A and B blocks, both sorted in row-major order.
+     * inner_origin is the first column of the A block and the first row of the B block.
+     */
+    void add_product(const std::vector<matrix_value<T>>& a, const std::vector<matrix_value<T>>& b,
+                     size_t inner_origin) {
+        std::fill(_b_row_begin.begin(), _b_row_begin.end(), 0);
+        for (const auto& value : b) {
+            _b_row_begin[value.i - inner_origin + 1]++;
+        }
+        for (size_t r = 0; r < _inner; r++) {
+            _b_row_begin[r + 1] += _b_row_begin[r];
+        }
+
+        for (const auto& a_value : a) {
+            size_t b_row = a_value.j - inner_origin;
+            size_t cell_row = (a_value.i - _row_origin) * _columns;
+            for (uint32_t idx = _b_row_begin[b_row]; idx < _b_row_begin[b_row + 1]; idx++) {
+                const auto& b_value = b[idx];
+                add(cell_row + (b_value.j - _column_origin), static_cast<double>(a_value.val) * b_value.val);
+            }
+        }
+    }
+
+    /* Appends the accumulated cells to out in row-major order and clears the scratchpad. */
+    void extract(std::vector<matrix_value<T>>& out) {
+        if (_dense) {
+            for (size_t word = 0; word < _occupied.size(); word++) {
+                uint64_t bits = _occupied[word];
+                while (bits != 0) {
+                    size_t cell = word * 64 + __builtin_ctzll(bits);
+                    bits &= bits - 1;
+                    out.emplace_back(_row_origin + cell / _columns, _column_origin + cell % _columns,
+                                     static_cast<T>(_sums[cell]));
+                    _sums[cell] = 0.0;
+                }
+                _occupied[word] = 0;
+            }
+            return;
+        }
+
+        _sorted.clear();
+        for (size_t slot : _touched) {
+            _sorted.emplace_back(_hash_cells[slot] - 1, _hash_sums[slot]);
+            _hash_cells[slot] = 0;
+            _hash_sums[slot] = 0.0;
+        }
+        _hash_size = 0;
+        _touched.clear();
+        std::sort(_sorted.begin(), _sorted.end(), [](auto& a, auto& b) {
+            return a.first < b.first;
+        });
+        for (auto& [cell, sum] : _sorted) {
+            out.emplace_back(_row_origin + cell / _columns, _column_origin + cell % _columns, static_cast<T>(sum));
+        }
+    }
+};
@@ -0,0 +1,227 @@
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include "coo_block_cache.hh"
+#include "coo_block_codec.hh"
+#include "coo_block_kernel.hh"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE coo_components_test
+#include <boost/test/unit_test.hpp>
+
+using block_t = std::vector<matrix_value<float>>;
+
+/* Block of cells (row, column) with value row * 1000 + column, in row-major order */
+block_t make_block(const std::vector<std::pair<size_t, size_t>>& cells) {
+    block_t block;
+    for (auto [i, j] : cells) {
+        block.emplace_back(i, j, float(i * 1000 + j));
+    }
+    return block;
+}
+
+/* Product of two blocks computed cell by cell */
+std::map<std::pair<size_t, size_t>, double> naive_product(const block_t& a, const block_t& b) {
+    std::map<std::pair<size_t, size_t>, double> product;
+    for (auto& a_value : a) {
+        for (auto& b_value : b) {
+            if (a_value.j == b_value.i) {
+                product[{a_value.i, b_value.j}] += double(a_value.val) * b_value.val;
+            }
+        }
+    }
+    return product;
+}
+
+void check_product(coo_block_accumulator<float>& accumulator, const block_t& a, const block_t& b,
+                   size_t row_origin, size_t column_origin, size_t inner_origin, size_t estimated_cells) {
+    accumulator.reset(row_origin, column_origin, estimated_cells);
+    accumulator.add_product(a, b, inner_origin);
+    block_t out;
+    accumulator.extract(out);
+
+    auto expected = naive_product(a, b);
+    BOOST_TEST(out.size() == expected.size());
+    auto it = expected.begin();
+    for (size_t k = 0; k < out.size() && it != expected.end(); k++, it++) {
+        BOOST_TEST(out[k].i == it->first.first);
+        BOOST_TEST(out[k].j == it->first.second);
+        BOOST_TEST(out[k].val == float(it->second));
+    }
+}
+
+/* Cache over blocks numbered by their block id, each holding one value, counting the fetches */
+struct test_cache {
+    std::map<size_t, size_t> next_uses;
+    size_t fetches = 0;
+    size_t failures_left = 0;
+    coo_block_cache<float> cache;
+
+    explicit test_cache(size_t blocks)
+            : cache(blocks * (sizeof(block_t) + sizeof(matrix_value<float>)),
+                    [this](size_t matrix_id, size_t block_id) {
+                        fetches++;
+                        bool fail = failures_left > 0;
+                        if (fail) failures_left--;
+                        return coo_block_cache<float>::pending_fetch_t([fail, block_id] {
+                            if (fail) throw std::runtime_error("Query error");
+                            return make_block({{block_id, 1}});
+                        });
+                    },
+                    [this](const coo_block_cache<float>::key_t& key) {
+                        auto it = next_uses.find(key.second);
+                        return it == next_uses.end() ? coo_block_cache<float>::never_used : it->second;
+                    }) {}
+};
+
+BOOST_AUTO_TEST_SUITE(coo_block_codec_test)
+    BOOST_AUTO_TEST_CASE(test_round_trip) {
+        block_t block = make_block({{100, 7}, {100, 65000}, {101, 5}, {164, 64}, {40000, 6}});
+        std::vector<uint8_t> encoded;
+        encode_coo_block(block, encoded);
+        BOOST_TEST(encoded.size() == coo_block_encoded_size(block.size(), sizeof(float)));
+
+        block_t decoded;
+        decode_coo_block(encoded.data(), encoded.size(), decoded);
+        BOOST_TEST(decoded.size() == block.size());
+        for (size_t k = 0; k < block.size(); k++) {
+            BOOST_TEST(decoded[k].i == block[k].i);
+            BOOST_TEST(decoded[k].j == block[k].j);
+            BOOST_TEST(decoded[k].val == block[k].val);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(test_empty_block) {
+        std::vector<uint8_t> encoded;
+        encode_coo_block(block_t(), encoded);
+        block_t decoded;
+        decode_coo_block(encoded.data(), encoded.size(), decoded);
+        BOOST_TEST(decoded.empty());
+    }
+
+    BOOST_AUTO_TEST_CASE(test_unencodable_blocks) {
+        std::vector<uint8_t> encoded;
+        BOOST_CHECK_THROW(encode_coo_block(make_block({{2, 1}, {1, 1}}), encoded), std::runtime_error);
+        BOOST_CHECK_THROW(encode_coo_block(make_block({{1, 2}, {1, 2}}), encoded), std::runtime_error);
+        BOOST_CHECK_THROW(encode_coo_block(make_block({{1, 1}, {70000, 1}}), encoded), std::runtime_error);
+        BOOST_CHECK_THROW(encode_coo_block(make_block({{1, 1}, {1, 70000}}), encoded), std::runtime_error);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_malformed_blocks) {
+        std::vector<uint8_t> encoded;
+        encode_coo_block(make_block({{1, 1}, {2, 2}}), encoded);
+
+        std::vector<matrix_value<float>> decoded;
+        BOOST_CHECK_THROW(decode_coo_block(encoded.data(), 8, decoded), std::runtime_error);
+        BOOST_CHECK_THROW(decode_coo_block(encoded.data(), encoded.size() - 1, decoded), std::runtime_error);
+        std::vector<matrix_value<double>> wrong_type;
+        BOOST_CHECK_THROW(decode_coo_block(encoded.data(), encoded.size(), wrong_type), std::runtime_error);
+    }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(coo_block_accumulator_test)
+    /* Result block (2, 3) of 8 x 8 blocks, inner block 2 */
+    const size_t row_origin = 9, column_origin = 17, inner_origin = 9;
+
+    BOOST_AUTO_TEST_CASE(test_dense_and_hash_agree) {
+        block_t a = make_block({{9, 9}, {9, 16}, {12, 10}, {16, 9}, {16, 16}});
+        block_t b = make_block({{9, 17}, {9, 24}, {10, 20}, {16, 17}, {16, 18}});
+
+        coo_block_accumulator<float> accumulator(8, 8, 8);
+        check_product(accumulator, a, b, row_origin, column_origin, inner_origin, 64);
+        check_product(accumulator, a, b, row_origin, column_origin, inner_origin, 1);
+        check_product(accumulator, a, b, row_origin, column_origin, inner_origin, 64);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_hash_rehash_within_block) {
+        /* Every cell of a 64 x 64 block, estimated at a single one */
+        std::vector<std::pair<size_t, size_t>> a_cells, b_cells;
+        for (size_t k = 1; k <= 64; k++) {
+            a_cells.emplace_back(k, 1);
+            b_cells.emplace_back(1, k);
+        }
+        coo_block_accumulator<float> accumulator(64, 64, 1);
+        check_product(accumulator, make_block(a_cells), make_block(b_cells), 1, 1, 1, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_empty_product) {
+        coo_block_accumulator<float> accumulator(8, 8, 8);
+        check_product(accumulator, make_block({{9, 9}}), make_block({{10, 17}}), row_origin, column_origin,
+                      inner_origin, 0);
+    }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(coo_block_cache_test)
+    BOOST_AUTO_TEST_CASE(test_evicts_furthest_next_use) {
+        test_cache blocks(2);
+        blocks.next_uses = {{1, 10}, {2, 20}, {3, 5}};
+        blocks.cache.get(1, 1);
+        blocks.cache.get(1, 2);
+        blocks.cache.get(1, 3);
+        BOOST_TEST(blocks.fetches == 3);
+
+        /* Block 2 is used last, so it was evicted */
+        blocks.cache.get(1, 1);
+        blocks.cache.get(1, 3);
+        BOOST_TEST(blocks.fetches == 3);
+        blocks.cache.get(1, 2);
+        BOOST_TEST(blocks.fetches == 4);
+        BOOST_TEST(blocks.cache.hits() == 2);
+        BOOST_TEST(blocks.cache.misses() == 4);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_unused_block_not_kept) {
+        test_cache blocks(1);
+        blocks.next_uses = {{1, 10}};
+        blocks.cache.get(1, 1);
+        auto block = blocks.cache.get(1, 2);
+        BOOST_TEST(block->front().i == 2);
+
+        blocks.cache.get(1, 1);
+        BOOST_TEST(blocks.fetches == 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_stale_next_uses_refreshed) {
+        test_cache blocks(2);
+        blocks.next_uses = {{1, 1}, {2, 2}};
+        blocks.cache.get(1, 1);
+        blocks.cache.get(1, 2);
+
+        /* The schedule moved on: block 1 is now used last, after block 3 */
+        blocks.next_uses = {{1, 30}, {2, 2}, {3, 3}};
+        blocks.cache.get(1, 3);
+        blocks.cache.get(1, 2);
+        blocks.cache.get(1, 3);
+        BOOST_TEST(blocks.fetches == 3);
+        blocks.cache.get(1, 1);
+        BOOST_TEST(blocks.fetches == 4);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_prefetch) {
+        test_cache blocks(4);
+        blocks.next_uses = {{1, 1}, {2, 2}};
+        blocks.cache.prefetch(1, 1);
+        blocks.cache.prefetch(1, 1);
+        /* Blocks which are never used are not prefetched */
+        blocks.cache.prefetch(1, 3);
+        BOOST_TEST(blocks.fetches == 1);
+
+        BOOST_TEST(blocks.cache.get(1, 1)->front().i == 1);
+        BOOST_TEST(blocks.fetches == 1);
+        BOOST_TEST(blocks.cache.hits() == 1);
+        BOOST_TEST(blocks.cache.misses() == 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_failed_fetch_retried) {
+        test_cache blocks(2);
+        blocks.next_uses = {{1, 1}};
+        blocks.failures_left = 1;
+        blocks.cache.prefetch(1, 1);
+        BOOST_CHECK_THROW(blocks.cache.get(1, 1), std::runtime_error);
+
+        BOOST_TEST(blocks.cache.get(1, 1)->front().i == 1);
+        BOOST_TEST(blocks.fetches == 2);
+    }
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,12 +1,24 @@
 #include <algorithm>
+#include <atomic>
 #include <cassandra.h>
+#include <cmath>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "../multiplicator.hh"
+#include "../utils/async_executor.hh"
 #include "../utils/connector.hh"
 #include "../utils/requestor.hh"
+#include "../utils/work_stealing_pool.hh"
+#include "coo_block_cache.hh"
+#include "coo_block_codec.hh"
+#include "coo_block_kernel.hh"
 
 #ifdef DEBUG
 #define DBG(x) x
@@ -14,93 +26,280 @@
 #define DBG(x)
 #endif
 
+/* Block geometry of COO. The first loaded matrix (A) is split into row_block x inner_block blocks
+ * and the second one (B) into inner_block x column_block blocks, so the result has row_block x column_block
+ * blocks. Every block dimension has to be between 1 and 65536, and a result block can have at most
+ * max_result_block_cells cells, since every worker of multiply() may accumulate one in a dense scratchpad.
+ */
+struct coo_geometry {
+    /* 2^22 cells: 32 MiB of sums and a 512 KiB bitmap per worker */
+    static constexpr size_t max_result_block_cells = size_t(1) << 22;
+
+    size_t row_block = 64;
+    size_t inner_block = 64;
+    size_t column_block = 64;
+};
+
 template<typename T>
 class COO : public multiplicator<T> {
     using _block_t = std::vector<matrix_value<T>>;
     const std::string _namespace = "zpp";
     const std::string _table_name = "coo_test_matrix";
-    const int _block_size = 64;
     const size_t _result_id = 100;
+    const std::string _select_block_query =
+            "SELECT vals FROM " + _namespace + "." + _table_name + " WHERE block_id=? AND matrix_id=?;";
+    const std::string _insert_block_query =
+            "INSERT INTO " + _namespace + "." + _table_name + " (block_id, matrix_id, vals) VALUES (?, ?, ?);";
+    /* Nonempty blocks of every matrix, with their numbers of values */
+    const std::string _directory_table_name = "coo_block_directory";
+    const std::string _insert_directory_query =
+            "INSERT INTO " + _namespace + "." + _directory_table_name + " (matrix_id, block_id, nnz) VALUES (?, ?, ?);";
+    const std::string _select_directory_query =
+            "SELECT block_id, nnz FROM " + _namespace + "." + _directory_table_name + " WHERE matrix_id=?;";
     std::shared_ptr<connector> _conn;
+    async_executor _writer;
+    size_t _cache_bytes;
+    size_t _threads;
+    coo_geometry _geometry;
     size_t _matrix_id;
-    size_t _dimension;
 
-    void submit_block(_block_t& block, size_t block_id, size_t matrix_id) {
-        if (block.empty()) return;
+    /* Shape of a loaded matrix and of its blocks. Blocks are numbered from 1 in row-major order. */
+    struct matrix_layout {
+        size_t height, width;
+        size_t block_rows, block_columns;
 
-        requestor query(_conn);
-        query << "INSERT INTO " << _namespace << "." << _table_name << " (block_id, matrix_id, vals) "
-                 "   VALUES (" << block_id  << ", " << matrix_id << ", {";
+        size_t grid_rows() const {
+            return div_up(height, block_rows);
+        }
 
-        auto last = block.back();
-        block.pop_back();
+        size_t grid_columns() const {
+            return div_up(width, block_columns);
+        }
 
-        for (auto value : block) {
-            query << "(" << value.i << ", " << value.j << ", " << value.val << "), ";
+        size_t block_id(size_t block_row, size_t block_column) const {
+            return (block_row - 1) * grid_columns() + block_column;
         }
-        query << "(" << last.i << ", " << last.j << ", " << last.val << ")});";
 
-        query.send();
+        size_t block_id_for_cell(size_t i, size_t j) const {
+            return block_id(div_up(i, block_rows), div_up(j, block_columns));
+        }
+
+        /* (block row, block column) of a block id */
+        std::pair<size_t, size_t> block_position(size_t block_id) const {
+            return {(block_id - 1) / grid_columns() + 1, (block_id - 1) % grid_columns() + 1};
+        }
+    };
+    std::map<size_t, matrix_layout> _layouts;
+
+    void submit_block(const _block_t& block, size_t block_id, size_t matrix_id, execution_profile profile) {
+        if (block.empty()) return;
+
+        std::vector<uint8_t> encoded;
+        encode_coo_block(block, encoded);
+
+        requestor query(_conn, _insert_block_query);
+        query.set_profile(profile);
+        query.bind((int32_t)block_id, (int32_t)matrix_id, encoded);
+        query.send(_writer);
+
+        requestor directory_query(_conn, _insert_directory_query);
+        directory_query.set_profile(profile);
+        directory_query.bind((int32_t)matrix_id, (int32_t)block_id, (int32_t)block.size());
+        directory_query.send(_writer);
     }
 
-    _block_t get_block(size_t block_id, size_t matrix_id) {
-        requestor query(_conn);
-        query << "SELECT * FROM " << _namespace << "." << _table_name
-              << " WHERE block_id=" << block_id << " AND matrix_id=" << matrix_id << ";";
-        query.send();
+    /* Sends the read of a block and returns a function waiting for it and decoding the block */
+    std::function<_block_t()> start_get_block(size_t block_id, size_t matrix_id, execution_profile profile) {
+        auto query = std::make_shared<requestor>(_conn, _select_block_query);
+        query->set_profile(profile);
+        query->bind((int32_t)block_id, (int32_t)matrix_id);
+        query->send_async();
+
+        return [query] {
+            _block_t ret;
+
+            if (query->next_row()) {
+                const cass_byte_t* data;
+                size_t size;
+                if (cass_value_get_bytes(query->get_column(0), &data, &size) != CASS_OK) {
+                    throw std::runtime_error("Decode error");
+                }
+                decode_coo_block(data, size, ret);
+            }
+
+            return ret;
+        };
+    }
+
+    _block_t get_block(size_t block_id, size_t matrix_id, execution_profile profile = execution_profile::standard) {
+        return start_get_block(block_id, matrix_id, profile)();
+    }
 
-        std::vector<matrix_value<float>> ret;
+    static size_t div_up(size_t val, size_t divisor) {
+        return (val - 1) / divisor + 1;
+    }
 
-        if (query.next_row()) {
-            const CassValue* value_set = query.get_column("vals");
-            CassIterator* set_iterator = cass_iterator_from_collection(value_set);
-            while (cass_iterator_next(set_iterator)) {
-                int i, j; double val;
+    const matrix_layout& get_layout(size_t matrix_id) {
+        auto it = _layouts.find(matrix_id);
+        if (it == _layouts.end()) {
+            throw std::runtime_error("No matrix " + std::to_string(matrix_id));
+        }
+        return it->second;
+    }
 
-                const CassValue* value_tuple = cass_iterator_get_value(set_iterator);
-                CassIterator* tuple_iterator = cass_iterator_from_tuple(value_tuple);
+    /* Layout of the next loaded matrix: odd ones are left and even ones right operands */
+    matrix_layout next_layout(size_t height, size_t width) {
+        bool left = _matrix_id % 2 == 0;
+        return {height, width,
+                left ? _geometry.row_block : _geometry.inner_block,
+                left ? _geometry.inner_block : _geometry.column_block};
+    }
 
-                cass_iterator_next(tuple_iterator);
-                cass_value_get_int32(cass_iterator_get_value(tuple_iterator), &i);
+    /* nnz of every stored block of the matrix, by block id */
+    std::map<size_t, size_t> get_block_directory(size_t matrix_id, execution_profile profile) {
+        requestor query(_conn, _select_directory_query);
+        query.set_profile(profile);
+        query.bind((int32_t)matrix_id);
+        query.send();
 
-                cass_iterator_next(tuple_iterator);
-                cass_value_get_int32(cass_iterator_get_value(tuple_iterator), &j);
+        size_t block_id = query.column_index("block_id");
+        size_t nnz = query.column_index("nnz");
 
-                cass_iterator_next(tuple_iterator);
-                cass_value_get_double(cass_iterator_get_value(tuple_iterator), &val);
+        std::map<size_t, size_t> ret;
+        while (query.next_row()) {
+            ret.emplace(query.get<int32_t>(block_id), query.get<int32_t>(nnz));
+        }
+        return ret;
+    }
 
-                cass_iterator_free(tuple_iterator);
+    /* Result block (i, j) of multiply(), computed from operand pairs A(i, k) * B(k, j) for k in ks */
+    struct multiply_task {
+        size_t i, j;
+        std::vector<size_t> ks;
+        /* Estimated work: sum of nnz(A(i, k)) * nnz(B(k, j)) */
+        size_t cost;
+    };
+
+    /* Lists the result blocks having at least one pair of nonempty operand blocks,
+     * the most expensive first.
+     */
+    std::vector<multiply_task> plan_multiply(size_t first_id, size_t second_id) {
+        const matrix_layout& first = get_layout(first_id);
+        const matrix_layout& second = get_layout(second_id);
+
+        /* (k, nnz) of the nonempty blocks in every block row of A and (j, nnz) in every block row k of B,
+         * both ordered by the block column
+         */
+        std::vector<std::vector<std::pair<size_t, size_t>>> a_rows(first.grid_rows() + 1);
+        std::vector<std::vector<std::pair<size_t, size_t>>> b_rows(second.grid_rows() + 1);
+        for (auto [block_id, nnz] : get_block_directory(first_id, execution_profile::hot_read)) {
+            auto [i, k] = first.block_position(block_id);
+            a_rows[i].emplace_back(k, nnz);
+        }
+        for (auto [block_id, nnz] : get_block_directory(second_id, execution_profile::hot_read)) {
+            auto [k, j] = second.block_position(block_id);
+            b_rows[k].emplace_back(j, nnz);
+        }
 
-                ret.emplace_back(i, j, val);
+        /* Joins A(i, k) with B(k, j) on k, so the cost is proportional to the number of nonempty pairs.
+         * Tasks of the current block row are found by their block column, ks come in increasing order.
+         */
+        constexpr size_t no_task = std::numeric_limits<size_t>::max();
+        std::vector<size_t> task_of_column(second.grid_columns() + 1, no_task);
+        std::vector<size_t> touched_columns;
+        std::vector<multiply_task> tasks;
+        for (size_t i = 1; i < a_rows.size(); i++) {
+            for (auto [k, a_nnz] : a_rows[i]) {
+                if (k >= b_rows.size()) continue;
+                for (auto [j, b_nnz] : b_rows[k]) {
+                    if (task_of_column[j] == no_task) {
+                        task_of_column[j] = tasks.size();
+                        touched_columns.push_back(j);
+                        tasks.push_back(multiply_task{i, j, {}, 0});
+                    }
+                    multiply_task& task = tasks[task_of_column[j]];
+                    task.ks.push_back(k);
+                    task.cost += a_nnz * b_nnz;
+                }
+            }
+            for (size_t j : touched_columns) {
+                task_of_column[j] = no_task;
             }
-            cass_iterator_free(set_iterator);
+            touched_columns.clear();
         }
 
-        return ret;
+        std::stable_sort(tasks.begin(), tasks.end(), [](const multiply_task& a, const multiply_task& b) {
+            return a.cost > b.cost;
+        });
+        return tasks;
     }
 
-    size_t div_up(size_t val, size_t divisor) {
-        return (val - 1) / divisor + 1;
+    void submit_block_row(std::vector<_block_t>& blocks, size_t block_row, size_t matrix_id,
+                          const matrix_layout& layout) {
+        for (size_t k = 0; k < blocks.size(); k++) {
+            submit_block(blocks[k], layout.block_id(block_row, k + 1), matrix_id, execution_profile::bulk_load);
+            blocks[k].clear();
+        }
     }
 
-    size_t get_block_index_for_cell(std::pair<size_t, size_t> pos) {
-        size_t first = div_up(pos.first, _block_size);
-        size_t second = div_up(pos.second, _block_size);
-        return div_up(_dimension, _block_size) * (first - 1) + second;
+    /* Loads values of a row-ordered generator. Distinct generators may be loaded concurrently
+     * as long as their rows do not share a block row.
+     */
+    void load_part(matrix_value_generator<T>& gen, size_t matrix_id, const matrix_layout& layout) {
+        size_t block_row = 0;
+        std::vector<_block_t> blocks(layout.grid_columns());
+        std::vector<matrix_value<T>> batch;
+        batch.reserve(matrix_value_generator<T>::default_batch_size);
+
+        while (gen.next_batch(batch, matrix_value_generator<T>::default_batch_size) > 0) {
+            for (auto &next : batch) {
+                DBG(std::cerr << "Next number in generator: (" << next.i << ", " << next.j << ")" << std::endl;)
+                if (div_up(next.i, layout.block_rows) != block_row) {
+                    if (block_row != 0) {
+                        submit_block_row(blocks, block_row, matrix_id, layout);
+                    }
+                    block_row = div_up(next.i, layout.block_rows);
+                }
+
+                blocks[div_up(next.j, layout.block_columns) - 1].push_back(next);
+            }
+            batch.clear();
+        }
+
+        /* Submit the remainder */
+        if (block_row != 0) {
+            submit_block_row(blocks, block_row, matrix_id, layout);
+        }
     }
 
-    void transpose_block(_block_t& b) {
-        for (auto &cell : b) {
-            std::swap(cell.i, cell.j);
+    static void check_block_dimension(size_t size) {
+        if (size == 0 || size > size_t(std::numeric_limits<uint16_t>::max()) + 1) {
+            throw std::runtime_error("Wrong block size of " + std::to_string(size));
         }
+    }
 
-        /* Replace with bucket sort */
-        std::sort(b.begin(), b.end(), [](auto a, auto b){
-            return std::make_pair(a.i, a.j) < std::make_pair(b.i, b.j);
-        });
+    static void check_geometry(const coo_geometry& geometry) {
+        check_block_dimension(geometry.row_block);
+        check_block_dimension(geometry.inner_block);
+        check_block_dimension(geometry.column_block);
+        if (geometry.row_block * geometry.column_block > coo_geometry::max_result_block_cells) {
+            throw std::runtime_error("Wrong result block size of " + std::to_string(geometry.row_block) + "x" +
+                                     std::to_string(geometry.column_block) + ", at most " +
+                                     std::to_string(coo_geometry::max_result_block_cells) + " cells are allowed");
+        }
     }
+
 public:
-    COO(std::shared_ptr<connector> conn) : _conn(conn), _matrix_id(0), _dimension(0) {
+    /* Memory budget of blocks kept between the steps of multiply() */
+    static constexpr size_t default_cache_bytes = 256 << 20;
+
+    /* threads is the number of threads of multiply(), zero means one per hardware thread */
+    COO(std::shared_ptr<connector> conn, size_t max_in_flight = async_executor::default_max_in_flight,
+        size_t cache_bytes = default_cache_bytes, size_t threads = 0, const coo_geometry& geometry = coo_geometry())
+            : _conn(conn), _writer(conn, max_in_flight), _cache_bytes(cache_bytes), _threads(threads),
+              _geometry(geometry), _matrix_id(0) {
+        check_geometry(_geometry);
+
         /* Make sure that the necessary namespaces and table exist */
 
         requestor namespace_query(_conn);
@@ -118,100 +317,202 @@ public:
         table_query << "CREATE TABLE " << _namespace << "." << _table_name << " ("
                        "    block_id int, "
                        "    matrix_id int, "
-                       "    vals set<frozen<tuple<int, int, double>>>, "
-                       "    PRIMARY KEY (block_id, matrix_id) "
-                       ") WITH CLUSTERING ORDER BY (matrix_id ASC);";
+                       "    vals blob, "
+                       "    PRIMARY KEY ((block_id, matrix_id)) "
+                       ");";
         table_query.send();
+
+        requestor directory_erase(_conn);
+        directory_erase << "DROP TABLE IF EXISTS " << _namespace << "." << _directory_table_name << ";";
+        directory_erase.send();
+
+        requestor directory_query(_conn);
+        directory_query << "CREATE TABLE " << _namespace << "." << _directory_table_name << " ("
+                           "    matrix_id int, "
+                           "    block_id int, "
+                           "    nnz int, "
+                           "    PRIMARY KEY (matrix_id, block_id) "
+                           ") WITH CLUSTERING ORDER BY (block_id ASC);";
+        directory_query.send();
     }
 
     void load_matrix(matrix_value_generator<T>&& gen) {
-        if (gen.width() != gen.height() || _dimension != 0 && gen.width() != _dimension) {
-            throw std::runtime_error("Wrong matrix size of " + std::to_string(gen.height()) + "x" + std::to_string(gen.width()));
+        matrix_layout layout = next_layout(gen.height(), gen.width());
+        _matrix_id++;
+        _layouts[_matrix_id] = layout;
+
+        DBG(std::cerr << "Generator has first number: " << gen.has_next() << std::endl;)
+
+        load_part(gen, _matrix_id, layout);
+        _writer.flush();
+
+        DBG(report_partition_skew(_matrix_id, std::cerr);)
+    }
+
+    /* Loads a matrix split into row ranges (e.g. by splittable_sparse_matrix_value_generator::split),
+     * each part on its own thread. Part boundaries have to be aligned to block_rows().
+     */
+    template<typename G>
+    void load_matrix_parallel(std::vector<G>&& parts) {
+        if (parts.empty()) return;
+        for (auto &part : parts) {
+            if (part.height() != parts.front().height() || part.width() != parts.front().width()) {
+                throw std::runtime_error("Wrong matrix size of " + std::to_string(part.height()) + "x" + std::to_string(part.width()));
+            }
         }
 
-        _dimension = gen.width();
+        matrix_layout layout = next_layout(parts.front().height(), parts.front().width());
         _matrix_id++;
+        _layouts[_matrix_id] = layout;
 
-        int next_batch_start = _block_size + 1;
-        size_t block_id = 0;
-        std::vector<_block_t> blocks(div_up(_dimension, _block_size));
+        std::vector<std::future<void>> loaders;
+        for (auto &part : parts) {
+            loaders.push_back(std::async(std::launch::async, [this, &part, &layout, matrix_id = _matrix_id] {
+                load_part(part, matrix_id, layout);
+            }));
+        }
+        for (auto &loader : loaders) {
+            loader.get();
+        }
+        _writer.flush();
 
-        DBG(std::cerr << "Generator has first number: " << gen.has_next() << std::endl;)
+        DBG(report_partition_skew(_matrix_id, std::cerr);)
+    }
 
-        while (gen.has_next()) {
-            matrix_value<T> next = gen.next();
-            DBG(std::cerr << "Next number in generator: (" << next.i << ", " << next.j << "), some are still left (T/F): " << gen.has_next() << std::endl;)
-            while (next.i >= next_batch_start) {
-                for (auto &b : blocks) {
-                    submit_block(b, ++block_id, _matrix_id);
-                    b.clear();
-                }
+    /* Height of the blocks of the next loaded matrix. Row ranges of parts passed to load_matrix_parallel
+     * have to be aligned to this value.
+     */
+    size_t block_rows() {
+        return next_layout(0, 0).block_rows;
+    }
 
-                next_batch_start += _block_size;
+    /* Prints how the values of a loaded matrix are spread over its partitions (one per nonempty block).
+     * A max/mean far above 1 means a few partitions, and the replicas and shards owning them,
+     * take most of the load; smaller or differently shaped blocks even it out.
+     */
+    void report_partition_skew(size_t matrix_id, std::ostream& out) {
+        auto directory = get_block_directory(matrix_id, execution_profile::standard);
+
+        size_t values = 0, max_values = 0, max_block = 0;
+        for (auto [block_id, nnz] : directory) {
+            values += nnz;
+            if (nnz > max_values) {
+                max_values = nnz;
+                max_block = block_id;
             }
-
-            blocks[div_up(next.j, _block_size) - 1].push_back(next);
         }
 
-        /* Submit the remainder */
-        for (auto &b : blocks) {
-            submit_block(b, ++block_id, _matrix_id);
-            b.clear();
+        double mean = directory.empty() ? 0 : double(values) / directory.size();
+        double variance = 0;
+        for (auto [block_id, nnz] : directory) {
+            variance += (nnz - mean) * (nnz - mean);
         }
+        double stddev = directory.empty() ? 0 : std::sqrt(variance / directory.size());
+
+        out << "Matrix " << matrix_id << ": " << directory.size() << " partitions, " << values << " values, "
+            << "mean " << mean << ", stddev " << stddev << ", max " << max_values << " in block " << max_block
+            << " (" << coo_block_encoded_size(max_values, sizeof(T)) << " bytes), "
+            << "max/mean " << (mean == 0 ? 0 : max_values / mean) << std::endl;
     }
 
-    /* Multiplies two matrices loaded into Scylla with load_matrix. */
+    /* Multiplies two matrices loaded into Scylla with load_matrix.
+     * Only pairs of nonempty operand blocks, listed in the block directory, are fetched and multiplied.
+     * Result blocks are computed in parallel by a work-stealing pool; the workers share the block cache
+     * and the asynchronous writer. Within a result block, the operands of the next step are fetched
+     * in the background while the current pair is multiplied.
+     */
     void multiply() {
-        size_t blocks_dimension = div_up(_dimension, _block_size);
-
-        for (size_t i = 1; i <= blocks_dimension; i++) {
-            for (size_t j = 1; j <= blocks_dimension; j++) {
-                /* We can use a vector, but that will be a bit more difficult */
-                std::map<std::pair<int, int>, double> result;
-
-                for (size_t k = 1; k <= blocks_dimension; k++) {
-                    _block_t copy_from_a = get_block((i - 1) * blocks_dimension + k, 1);
-                    _block_t copy_from_b = get_block((k - 1) * blocks_dimension + j, 2);
-
-                    /* Strategy: for every row of copy_from_a process all rows of copy_from_b */
-                    auto it_1 = copy_from_a.begin();
-
-                    /* Multiplication: (i, k) * (k, j) -> (i, j), summed over k = 1..dimension */
-                    while (it_1 != copy_from_a.end()) {
-                        size_t row = it_1->i;
-                        auto it_2 = copy_from_b.begin();
-
-                        while (it_1 != copy_from_a.end() && it_2 != copy_from_b.end() && it_1->i == row) {
-                            if (it_1->j < it_2->i) {
-                                it_1++;
-                            } else if (it_1->j > it_2->i) {
-                                it_2++;
-                            } else {
-                                /* it_1->j == it_2->i == k */
-                                result[std::make_pair(it_1->i, it_2->j)] += it_1->val * it_2->val;
-                                it_2++;
-                            }
-                        }
-
-                        while (it_1 != copy_from_a.end() && it_1->i == row) {
-                            it_1++;
-                        }
-                    }
-                }
+        const matrix_layout& first = get_layout(1);
+        const matrix_layout& second = get_layout(2);
+        if (first.width != second.height) {
+            throw std::runtime_error("Wrong matrix sizes of " + std::to_string(first.height) + "x" + std::to_string(first.width) +
+                                     " and " + std::to_string(second.height) + "x" + std::to_string(second.width));
+        }
+        const matrix_layout& result_layout = _layouts[_result_id] =
+                matrix_layout{first.height, second.width, first.block_rows, second.block_columns};
+
+        std::vector<multiply_task> tasks = plan_multiply(1, 2);
+
+        /* Flattened schedule: steps of task t start at first_step[t]; uses lists the steps using every block */
+        std::vector<size_t> first_step;
+        std::map<std::pair<size_t, size_t>, std::vector<size_t>> uses;
+        size_t step_count = 0;
+        for (auto& task : tasks) {
+            first_step.push_back(step_count);
+            for (size_t k : task.ks) {
+                uses[{1, first.block_id(task.i, k)}].push_back(step_count);
+                uses[{2, second.block_id(k, task.j)}].push_back(step_count);
+                step_count++;
+            }
+        }
+
+        work_stealing_pool pool(_threads);
+
+        /* Step every worker is at. Since the workers follow the schedule only roughly,
+         * next uses are counted from the slowest one.
+         */
+        std::vector<std::atomic<size_t>> worker_steps(pool.threads());
+        for (auto& worker_step : worker_steps) {
+            worker_step = coo_block_cache<T>::never_used;
+        }
 
-                _block_t result_block;
-                for (auto a : result) {
-                    result_block.emplace_back(a.first.first, a.first.second, a.second);
+        coo_block_cache<T> cache(
+                _cache_bytes,
+                [this](size_t matrix_id, size_t block_id) {
+                    return start_get_block(block_id, matrix_id, execution_profile::hot_read);
+                },
+                [&](const std::pair<size_t, size_t>& key) {
+                    size_t progress = coo_block_cache<T>::never_used;
+                    for (auto& worker_step : worker_steps) {
+                        progress = std::min<size_t>(progress, worker_step);
+                    }
+                    auto it = uses.find(key);
+                    if (it == uses.end()) return coo_block_cache<T>::never_used;
+                    auto next = std::lower_bound(it->second.begin(), it->second.end(), progress);
+                    return next == it->second.end() ? coo_block_cache<T>::never_used : *next;
+                });
+
+        /* Every worker accumulates its current result block locally */
+        std::vector<coo_block_accumulator<T>> accumulators(
+                pool.threads(),
+                coo_block_accumulator<T>(first.block_rows, second.block_columns, first.block_columns));
+
+        pool.run(tasks.size(), [&](size_t task_idx, size_t worker) {
+            const multiply_task& task = tasks[task_idx];
+            auto& result = accumulators[worker];
+            result.reset((task.i - 1) * first.block_rows + 1, (task.j - 1) * second.block_columns + 1, task.cost);
+
+            for (size_t k_idx = 0; k_idx < task.ks.size(); k_idx++) {
+                worker_steps[worker] = first_step[task_idx] + k_idx;
+                size_t k = task.ks[k_idx];
+                auto block_a = cache.get(1, first.block_id(task.i, k));
+                auto block_b = cache.get(2, second.block_id(k, task.j));
+
+                /* Fetch the operands of the next step while this one is computed */
+                if (k_idx + 1 < task.ks.size()) {
+                    size_t next_k = task.ks[k_idx + 1];
+                    cache.prefetch(1, first.block_id(task.i, next_k));
+                    cache.prefetch(2, second.block_id(next_k, task.j));
                 }
 
-                submit_block(result_block, (i - 1) * blocks_dimension + j, _result_id);
+                result.add_product(*block_a, *block_b, (k - 1) * first.block_columns + 1);
             }
-        }
+            worker_steps[worker] = coo_block_cache<T>::never_used;
+
+            _block_t result_block;
+            result.extract(result_block);
+
+            submit_block(result_block, result_layout.block_id(task.i, task.j), _result_id,
+                         execution_profile::result_write);
+        });
+        _writer.flush();
+
+        DBG(std::cerr << "Block cache hits: " << cache.hits() << ", misses: " << cache.misses() << std::endl;)
     }
 
     /* Obtains the value in the multiplication result at (x; y) = (pos.first; pos.second) */
     T get_result(std::pair<size_t, size_t> pos) {
-        size_t block_id = get_block_index_for_cell(pos);
+        size_t block_id = get_layout(_result_id).block_id_for_cell(pos.first, pos.second);
 
         DBG(std::cerr << "Block for cell: " << pos.first << " " << pos.second << ": " << block_id << std::endl;)
 
@@ -224,4 +525,46 @@ public:
 
         return 0;
     }
+
+    /* Obtains the values in the multiplication result at every position, in the same order.
+     * Positions are grouped by result block, so every block is fetched once and its cells are looked up
+     * in a hash index instead of a linear scan. Like get_result, it reads with the standard (QUORUM) profile,
+     * so it sees every result write.
+     */
+    std::vector<T> get_results(const std::vector<std::pair<size_t, size_t>>& positions) override {
+        const matrix_layout& layout = get_layout(_result_id);
+
+        std::map<size_t, std::vector<size_t>> by_block;
+        for (size_t idx = 0; idx < positions.size(); idx++) {
+            by_block[layout.block_id_for_cell(positions[idx].first, positions[idx].second)].push_back(idx);
+        }
+
+        std::vector<T> ret(positions.size(), 0);
+        std::unordered_map<size_t, T> index;
+        for (auto& [block_id, requested] : by_block) {
+            auto block = get_block(block_id, _result_id, execution_profile::standard);
+            if (block.empty()) continue;
+
+            /* Cells are keyed by their offsets within the block */
+            auto [block_row, block_column] = layout.block_position(block_id);
+            size_t row_origin = (block_row - 1) * layout.block_rows + 1;
+            size_t column_origin = (block_column - 1) * layout.block_columns + 1;
+
+            index.clear();
+            index.reserve(block.size());
+            for (auto& val : block) {
+                index.emplace((val.i - row_origin) * layout.block_columns + (val.j - column_origin), val.val);
+            }
+
+            for (size_t idx : requested) {
+                auto it = index.find((positions[idx].first - row_origin) * layout.block_columns +
+                                     (positions[idx].second - column_origin));
+                if (it != index.end()) {
+                    ret[idx] = it->second;
+                }
+            }
+        }
+
+        return ret;
+    }
 };
@@ -0,0 +1,58 @@
+// Measures how COO::multiply scales with the number of worker threads.
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "coordinate_list.hh"
+#include "../float_value_factory.hh"
+#include "../sparse_matrix_value_generator.hh"
+
+/* Usage: coordinate_list_bench ADDRESS [DIMENSION] [VALUES] [MAX_THREADS]
+ * Loads two random matrices and multiplies them with 1, 2, 4, ... up to MAX_THREADS threads.
+ */
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " ADDRESS [DIMENSION] [VALUES] [MAX_THREADS]" << std::endl;
+        return 1;
+    }
+
+    const char* address = argv[1];
+    size_t dimension = argc > 2 ? std::stoull(argv[2]) : 2048;
+    size_t values = argc > 3 ? std::stoull(argv[3]) : 100000;
+    size_t max_threads = argc > 4 ? std::stoull(argv[4]) : std::max(1u, std::thread::hardware_concurrency());
+
+    std::shared_ptr<connector> conn;
+    try {
+        conn = std::make_shared<connector>(address);
+    } catch (std::exception& e) {
+        std::cerr << "Connection error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "threads\tseconds\tspeedup" << std::endl;
+    double single_thread_seconds = 0;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        COO<float> multiplicator(conn, async_executor::default_max_in_flight, COO<float>::default_cache_bytes, threads);
+        auto factory = std::make_shared<float_value_factory>(0.0, 100.0, 2137);
+        multiplicator.load_matrix(sparse_matrix_value_generator<float>(dimension, dimension, values, 2137, factory));
+        multiplicator.load_matrix(sparse_matrix_value_generator<float>(dimension, dimension, values, 2138, factory));
+        if (threads == 1) {
+            multiplicator.report_partition_skew(1, std::cerr);
+            multiplicator.report_partition_skew(2, std::cerr);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        multiplicator.multiply();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (threads == 1) {
+            single_thread_seconds = elapsed.count();
+        }
+        std::cout << threads << "\t" << elapsed.count() << "\t" << single_thread_seconds / elapsed.count() << std::endl;
+    }
+
+    return 0;
+}
@@ -22,5 +22,7 @@ int main(int argc, char* argv[]) {
     multiplicator_instance.multiply();
 
     multiplicator_instance.print_all();
+
+    query_stats::dump_json(std::cerr);
     return 0;
 }
@@ -7,6 +7,8 @@
 #include <random>
 #include <optional>
 #include "../multiplicator.hh"
+#include "../utils/async_executor.hh"
+#include "../utils/batch_writer.hh"
 #include "../utils/connector.hh"
 #include "../utils/requestor.hh"
 #include "../float_value_factory.hh"
@@ -18,102 +20,77 @@ private:
     const std::string _KEYSPACE_NAME = "zpp";
     const std::string _TABLE_NAME = "dok_test_matrix";
     const size_t _BLOCK_SIZE = 1000;
+    const std::string _INSERT_QUERY =
+            "INSERT INTO " + _KEYSPACE_NAME + "." + _TABLE_NAME + " (matrix_id, pos_y, pos_x, val) VALUES (?, ?, ?, ?);";
+    const std::string _SELECT_FROM_ROW_QUERY =
+            "SELECT pos_y, pos_x, val FROM " + _KEYSPACE_NAME + "." + _TABLE_NAME
+            + " WHERE pos_y>=? AND matrix_id=? LIMIT ?;";
+    const std::string _SELECT_FROM_COLUMN_QUERY =
+            "SELECT pos_y, pos_x, val FROM " + _KEYSPACE_NAME + "." + _TABLE_NAME
+            + " WHERE pos_x>=? AND pos_y=? AND matrix_id=? LIMIT ?;";
     std::shared_ptr<connector> _conn;
+    async_executor _writer;
+    batch_writer _batches;
     size_t _matrix_id;
     size_t result_id = 100;
     size_t _first_matrix_height, _first_matrix_width, _second_matrix_height, _second_matrix_width;
 
-    void submit_block(const std::vector<matrix_value<T>>& block, size_t matrix_id) {
+    void submit_block(const std::vector<matrix_value<T>>& block, size_t matrix_id, execution_profile profile) {
         if (block.empty()) return;
 
         for (auto val: block) {
-            requestor query(_conn);
-            query << "INSERT INTO " << _KEYSPACE_NAME << "." << _TABLE_NAME << " (matrix_id, pos_y, pos_x, val) "
-                                                                               "   VALUES ("
-                                                                               << matrix_id << ", "
-                                                                               << val.i << ", "
-                                                                               << val.j << ", "
-                                                                               << val.val << ");";
-            query.send();
+            requestor query(_conn, _INSERT_QUERY);
+            query.set_profile(profile);
+            query.bind((int32_t)matrix_id, (int64_t)val.i, (int64_t)val.j, (double)val.val);
+            query.send(_batches, (int64_t)matrix_id);
         }
     }
 
     inline std::optional<matrix_value<T>> fetch_next_coords(size_t min_pos_y, size_t matrix_id) {
-        requestor query(_conn);
-        query << "SELECT * FROM " << _KEYSPACE_NAME << "." << _TABLE_NAME
-              << " WHERE pos_y>=" << min_pos_y << " AND matrix_id=" << matrix_id
-              << " LIMIT " << 1 << ";";
+        requestor query(_conn, _SELECT_FROM_ROW_QUERY);
+        query.set_profile(execution_profile::hot_read);
+        query.bind((int64_t)min_pos_y, (int32_t)matrix_id, (int32_t)1);
         query.send();
 
-        if (query.next_row()) {
-            const CassValue* _cass_pos_x = query.get_column("pos_x");
-            const CassValue* _cass_pos_y = query.get_column("pos_y");
-            const CassValue* _cass_val = query.get_column("val");
-            cass_int64_t _pos_x, _pos_y;
-            cass_double_t _val;
-
-            cass_value_get_int64(_cass_pos_x, &_pos_x);
-            cass_value_get_int64(_cass_pos_y, &_pos_y);
-            cass_value_get_double(_cass_val, &_val);
-
-            return std::make_optional(matrix_value<T>(_pos_y, _pos_x, _val));
+        std::vector<matrix_value<T>> values;
+        if (query.read_values<int64_t, int64_t, double>(values, "pos_y", "pos_x", "val") > 0) {
+            return values.front();
         }
 
         return std::nullopt;
     }
 
     inline std::optional<matrix_value<T>> fetch_next_coords(size_t min_pos_x, size_t pos_y, size_t matrix_id) {
-        requestor query(_conn);
-        query << "SELECT * FROM " << _KEYSPACE_NAME << "." << _TABLE_NAME
-              << " WHERE pos_x>=" << min_pos_x << " AND pos_y=" << pos_y << " AND matrix_id=" << matrix_id
-              << " LIMIT " << 1 << ";";
+        requestor query(_conn, _SELECT_FROM_COLUMN_QUERY);
+        query.bind((int64_t)min_pos_x, (int64_t)pos_y, (int32_t)matrix_id, (int32_t)1);
         query.send();
 
-        if (query.next_row()) {
-            const CassValue* _cass_pos_x = query.get_column("pos_x");
-            const CassValue* _cass_pos_y = query.get_column("pos_y");
-            const CassValue* _cass_val = query.get_column("val");
-            cass_int64_t _pos_x, _pos_y;
-            cass_double_t _val;
-
-            cass_value_get_int64(_cass_pos_x, &_pos_x);
-            cass_value_get_int64(_cass_pos_y, &_pos_y);
-            cass_value_get_double(_cass_val, &_val);
-
-            return std::make_optional(matrix_value<T>(_pos_y, _pos_x, _val));
+        std::vector<matrix_value<T>> values;
+        if (query.read_values<int64_t, int64_t, double>(values, "pos_y", "pos_x", "val") > 0) {
+            return values.front();
         }
 
         return std::nullopt;
     }
 
     inline std::vector<matrix_value<T>> get_block(size_t min_pos_x, size_t pos_y, size_t matrix_id) {
-        requestor query(_conn);
-        query << "SELECT * FROM " << _KEYSPACE_NAME << "." << _TABLE_NAME
-              << " WHERE pos_x>=" << min_pos_x << " AND pos_y=" << pos_y << " AND matrix_id=" << matrix_id
-              << " LIMIT " << _BLOCK_SIZE << ";";
+        requestor query(_conn, _SELECT_FROM_COLUMN_QUERY);
+        query.set_profile(execution_profile::hot_read);
+        query.bind((int64_t)min_pos_x, (int64_t)pos_y, (int32_t)matrix_id, (int32_t)_BLOCK_SIZE);
         query.send();
 
         std::vector<matrix_value<T>> ret;
 
-        while (query.next_row()) {
-            const CassValue* _cass_pos_x = query.get_column("pos_x");
-            const CassValue* _cass_pos_y = query.get_column("pos_y");
-            const CassValue* _cass_val = query.get_column("val");
-            cass_int64_t _pos_x, _pos_y;
-            cass_double_t _val;
-
-            cass_value_get_int64(_cass_pos_x, &_pos_x);
-            cass_value_get_int64(_cass_pos_y, &_pos_y);
-            cass_value_get_double(_cass_val, &_val);
-
-            ret.emplace_back(_pos_y, _pos_x, _val);
-        }
+        ret.reserve(_BLOCK_SIZE);
+        query.read_values<int64_t, int64_t, double>(ret, "pos_y", "pos_x", "val");
 
         return ret;
     }
 
 public:
-    explicit DOK(std::shared_ptr<connector> conn) : _conn(conn), _matrix_id(0) {
+    explicit DOK(std::shared_ptr<connector> conn, size_t max_in_flight = async_executor::default_max_in_flight,
+                 size_t batch_size = batch_writer::default_batch_size)
+            : _conn(conn), _writer(conn, max_in_flight), _batches(_writer, batch_size), _matrix_id(0) {
         /* Make sure that the necessary namespaces and table exist */
 
         requestor namespace_query(_conn);
@@ -162,24 +139,30 @@ public:
         }
 
         std::vector<matrix_value<T>> _block;
+        std::vector<matrix_value<T>> _batch;
+        _batch.reserve(matrix_value_generator<T>::default_batch_size);
 
-        while (gen.has_next()) {
-            matrix_value<T> _next = gen.next();
-            std::cout << _next.i << " " << _next.j << " " << _next.val << " " << gen.has_next() << std::endl;
+        while (gen.next_batch(_batch, matrix_value_generator<T>::default_batch_size) > 0) {
+            for (matrix_value<T> _next : _batch) {
+#ifdef DEBUG
+                std::cerr << _next.i << " " << _next.j << " " << _next.val << std::endl;
+#endif
 
-            if (transpose) {
-                std::swap(_next.i, _next.j);
-            }
+                if (transpose) {
+                    std::swap(_next.i, _next.j);
+                }
 
-            _block.push_back(_next);
+                _block.push_back(_next);
 
-            if (_block.size() >= _BLOCK_SIZE) {
-                submit_block(_block, _matrix_id);
-                _block.clear();
+                if (_block.size() >= _BLOCK_SIZE) {
+                    submit_block(_block, _matrix_id, execution_profile::bulk_load);
+                    _block.clear();
+                }
             }
-
+            _batch.clear();
         }
-        submit_block(_block, _matrix_id);
+        submit_block(_block, _matrix_id, execution_profile::bulk_load);
+        _batches.flush();
     }
 
     // TODO wrap dynamically loaded vectors into abstraction, make this function simpler.
@@ -232,13 +215,14 @@ public:
                 if (_sum != 0) {
                     std::vector<matrix_value<T>> _upload_block;
                     _upload_block.emplace_back(_s_start->i, _f_start->i, _sum);
-                    submit_block(_upload_block, result_id);
+                    submit_block(_upload_block, result_id, execution_profile::result_write);
                 }
 
                 _s_start = fetch_next_coords(_s_start->i + 1, 2);
             }
             _f_start = fetch_next_coords(_f_start->i + 1, 1);
         }
+        _batches.flush();
     }
 
     /* Obtains the value in the multiplication result at (x; y) = (pos.first; pos.second) */
@@ -253,20 +237,17 @@ public:
     void print_all() {
         requestor query(_conn);
         query << "SELECT * FROM " << _KEYSPACE_NAME << "." << _TABLE_NAME
-              << " WHERE matrix_id=" << result_id
-              << " LIMIT " << _BLOCK_SIZE << ";";
+              << " WHERE matrix_id=" << result_id << ";";
         query.send();
 
+        size_t pos_x = query.column_index("pos_x");
+        size_t pos_y = query.column_index("pos_y");
+        size_t val = query.column_index("val");
+
         while (query.next_row()) {
-            const CassValue* _cass_pos_x = query.get_column("pos_x");
-            const CassValue* _cass_pos_y = query.get_column("pos_y");
-            const CassValue* _cass_val = query.get_column("val");
-            cass_int64_t _pos_x, _pos_y;
-            cass_double_t _val;
-
-            cass_value_get_int64(_cass_pos_x, &_pos_x);
-            cass_value_get_int64(_cass_pos_y, &_pos_y);
-            cass_value_get_double(_cass_val, &_val);
+            auto _pos_x = query.get<int64_t>(pos_x);
+            auto _pos_y = query.get<int64_t>(pos_y);
+            auto _val = query.get<double>(val);
 
             std::cout << "(" << _pos_y << ", " << _pos_x << "): "  << _val << std::endl;
         }
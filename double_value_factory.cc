@@ -1,12 +1,15 @@
 #include "double_value_factory.hh"
 
-double_value_factory::double_value_factory(double min, double max, int seed) {
-    this->_min = min;
-    this->_max = max;
-    this->_rng = std::mt19937(seed);
-    this->_dist = std::uniform_real_distribution<double>(min, max);
-}
+double_value_factory::double_value_factory(double min, double max, int seed) : _min(min), _max(max), _dist(min, max, seed) {}
 
 double double_value_factory::next() {
-    return _dist(_rng);
+    return _dist.next();
+}
+
+void double_value_factory::fill(double* out, size_t count) {
+    _dist.fill(out, count);
+}
+
+std::shared_ptr<matrix_value_factory<double>> double_value_factory::fork(int seed) const {
+    return std::make_shared<double_value_factory>(_min, _max, seed);
 }
\ No newline at end of file
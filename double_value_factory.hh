@@ -1,16 +1,19 @@
 #pragma once
 
-#include <random>
 #include "matrix_value_factory.hh"
+#include "utils/xoshiro256.hh"
 
 class double_value_factory: public matrix_value_factory<double> {
 private:
-    std::mt19937 _rng;
     double _min, _max;
-    std::uniform_real_distribution<double> _dist;
+    uniform_real_lanes<double> _dist;
 
 public:
     double_value_factory(double min, double max, int seed);
 
     double next() override;
+
+    void fill(double* out, size_t count) override;
+
+    std::shared_ptr<matrix_value_factory<double>> fork(int seed) const override;
 };
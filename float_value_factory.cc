@@ -1,12 +1,15 @@
 #include "float_value_factory.hh"
 
-float_value_factory::float_value_factory(float min, float max, int seed) {
-    this->_min = min;
-    this->_max = max;
-    this->_rng = std::mt19937(seed);
-    this->_dist = std::uniform_real_distribution<float>(min, max);
-}
+float_value_factory::float_value_factory(float min, float max, int seed) : _min(min), _max(max), _dist(min, max, seed) {}
 
 float float_value_factory::next() {
-    return _dist(_rng);
+    return _dist.next();
+}
+
+void float_value_factory::fill(float* out, size_t count) {
+    _dist.fill(out, count);
+}
+
+std::shared_ptr<matrix_value_factory<float>> float_value_factory::fork(int seed) const {
+    return std::make_shared<float_value_factory>(_min, _max, seed);
 }
\ No newline at end of file
@@ -1,16 +1,19 @@
 #pragma once
 
-#include <random>
 #include "matrix_value_factory.hh"
+#include "utils/xoshiro256.hh"
 
 class float_value_factory: public matrix_value_factory<float> {
 private:
-    std::mt19937 _rng;
     float _min, _max;
-    std::uniform_real_distribution<float> _dist;
+    uniform_real_lanes<float> _dist;
 
 public:
     float_value_factory(float min, float max, int seed);
 
     float next() override;
+
+    void fill(float* out, size_t count) override;
+
+    std::shared_ptr<matrix_value_factory<float>> fork(int seed) const override;
 };
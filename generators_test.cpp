@@ -0,0 +1,273 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "banded_matrix_value_generator.hh"
+#include "binary_matrix_value_generator.hh"
+#include "block_diagonal_matrix_value_generator.hh"
+#include "float_value_factory.hh"
+#include "matrix_market_value_generator.hh"
+#include "rmat_matrix_value_generator.hh"
+#include "sparse_matrix_value_generator.hh"
+#include "splittable_sparse_matrix_value_generator.hh"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE generators_test
+#include <boost/test/unit_test.hpp>
+
+using values_t = std::vector<matrix_value<float>>;
+
+/* Batch sizes around the chunks the generators draw values in */
+const std::vector<size_t> batch_sizes = {1, 3, 64, 1000, matrix_value_generator<float>::default_batch_size};
+
+std::shared_ptr<float_value_factory> test_factory() {
+    return std::make_shared<float_value_factory>(0.0, 100.0, 17);
+}
+
+values_t drain_next(matrix_value_generator<float>& gen) {
+    values_t values;
+    while (gen.has_next()) {
+        values.push_back(gen.next());
+    }
+    return values;
+}
+
+values_t drain_batches(matrix_value_generator<float>& gen, size_t batch_size) {
+    values_t values;
+    size_t appended;
+    while ((appended = gen.next_batch(values, batch_size)) > 0) {
+        BOOST_TEST(appended <= batch_size);
+    }
+    BOOST_TEST(!gen.has_next());
+    return values;
+}
+
+/* Compares positions and exact values; matrix_value<float>::operator== only compares positions loosely */
+void check_same_values(const values_t& got, const values_t& expected) {
+    BOOST_TEST(got.size() == expected.size());
+    for (size_t k = 0; k < got.size() && k < expected.size(); k++) {
+        BOOST_TEST(got[k].i == expected[k].i);
+        BOOST_TEST(got[k].j == expected[k].j);
+        BOOST_TEST(got[k].val == expected[k].val);
+    }
+}
+
+void check_row_major(const values_t& values, size_t height, size_t width) {
+    for (size_t k = 0; k < values.size(); k++) {
+        BOOST_TEST((values[k].i >= 1 && values[k].i <= height && values[k].j >= 1 && values[k].j <= width));
+        if (k > 0) {
+            BOOST_TEST((values[k - 1].i < values[k].i || (values[k - 1].i == values[k].i && values[k - 1].j < values[k].j)));
+        }
+    }
+}
+
+/* next_batch yields the same values as next(), for every batch size */
+template <typename Make>
+values_t check_batches_match_next(Make make) {
+    auto reference = make();
+    values_t expected = drain_next(reference);
+    for (size_t batch_size : batch_sizes) {
+        auto gen = make();
+        check_same_values(drain_batches(gen, batch_size), expected);
+    }
+    return expected;
+}
+
+/* Generator of fixed values, which may break the invariants of real generators */
+class list_generator : public matrix_value_generator<float> {
+    size_t _height, _width;
+    values_t _values;
+    size_t _next;
+
+public:
+    list_generator(size_t height, size_t width, values_t values)
+            : _height(height), _width(width), _values(std::move(values)), _next(0) {}
+
+    bool has_next() {
+        return _next < _values.size();
+    }
+
+    matrix_value<float> next() {
+        return _values[_next++];
+    }
+
+    size_t height() {
+        return _height;
+    }
+
+    size_t width() {
+        return _width;
+    }
+};
+
+/* Path of a file in the temporary directory, removed at the end of the test */
+struct temp_file {
+    std::string path;
+
+    explicit temp_file(const std::string& name)
+            : path((std::filesystem::temp_directory_path() / ("generators_test_" + name)).string()) {}
+
+    ~temp_file() {
+        std::remove(path.c_str());
+    }
+};
+
+BOOST_AUTO_TEST_SUITE(batched_generators_test)
+    BOOST_AUTO_TEST_CASE(test_sparse) {
+        auto values = check_batches_match_next([] {
+            return sparse_matrix_value_generator<float>(50, 40, 300, 3, test_factory());
+        });
+        /* The number of values is only a suggestion */
+        BOOST_TEST((!values.empty() && values.size() <= 300));
+        check_row_major(values, 50, 40);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_sparse_full) {
+        /* More values suggested than there are cells */
+        auto values = check_batches_match_next([] {
+            return sparse_matrix_value_generator<float>(4, 5, 100, 3, test_factory());
+        });
+        check_row_major(values, 4, 5);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_splittable) {
+        auto values = check_batches_match_next([] {
+            return splittable_sparse_matrix_value_generator<float>(300, 200, 5000, 7, test_factory(), 16);
+        });
+        check_row_major(values, 300, 200);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_splittable_parts) {
+        splittable_sparse_matrix_value_generator<float> whole(300, 200, 5000, 7, test_factory(), 16);
+        auto parts = whole.split(4, 32);
+        values_t expected = drain_next(whole);
+
+        /* Parts are aligned, start where the previous one ended and yield the values of the whole matrix */
+        values_t joined;
+        size_t row_begin = 1;
+        for (auto& part : parts) {
+            BOOST_TEST(part.row_begin() == row_begin);
+            BOOST_TEST((part.row_begin() - 1) % 32 == 0);
+            row_begin = part.row_end();
+            values_t values = drain_batches(part, 64);
+            joined.insert(joined.end(), values.begin(), values.end());
+        }
+        BOOST_TEST(row_begin == 301);
+        check_same_values(joined, expected);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_banded) {
+        auto values = check_batches_match_next([] {
+            return banded_matrix_value_generator<float>(60, 50, 2, 3, 200, 5, test_factory());
+        });
+        check_row_major(values, 60, 50);
+        for (auto& value : values) {
+            BOOST_TEST((value.j + 2 >= value.i && value.j <= value.i + 3));
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(test_block_diagonal) {
+        auto values = check_batches_match_next([] {
+            return block_diagonal_matrix_value_generator<float>(70, 70, 8, 300, 5, test_factory());
+        });
+        check_row_major(values, 70, 70);
+        for (auto& value : values) {
+            BOOST_TEST((value.i - 1) / 8 == (value.j - 1) / 8);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(test_block_diagonal_zero_block) {
+        BOOST_CHECK_THROW(block_diagonal_matrix_value_generator<float>(10, 10, 0, 10, 5, test_factory()),
+                          std::runtime_error);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_rmat) {
+        auto values = check_batches_match_next([] {
+            return rmat_matrix_value_generator<float>(100, 80, 500, 9, test_factory());
+        });
+        check_row_major(values, 100, 80);
+        BOOST_TEST(values.size() == 500);
+    }
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(file_generators_test)
+    BOOST_AUTO_TEST_CASE(test_matrix_market_spilled_runs) {
+        temp_file file("symmetric.mtx");
+        {
+            std::ofstream out(file.path);
+            out << "%%MatrixMarket matrix coordinate real symmetric\n"
+                   "% comment\n"
+                   "5 5 6\n"
+                   "5 1 1.5\n"
+                   "2 2 2\n"
+                   "4 3 -1\n"
+                   "3 1 4\n"
+                   "5 5 3\n"
+                   "2 1 0.5\n";
+        }
+
+        /* Chunks of 2 values, so the entries are merged from several sorted runs */
+        values_t expected = {{1, 2, 0.5f}, {1, 3, 4.0f}, {1, 5, 1.5f}, {2, 1, 0.5f}, {2, 2, 2.0f}, {3, 1, 4.0f},
+                             {3, 4, -1.0f}, {4, 3, -1.0f}, {5, 1, 1.5f}, {5, 5, 3.0f}};
+        for (size_t batch_size : {1, 3, 64}) {
+            matrix_market_value_generator<float> gen(file.path, 2);
+            BOOST_TEST(gen.height() == 5);
+            BOOST_TEST(gen.width() == 5);
+            check_same_values(drain_batches(gen, batch_size), expected);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(test_matrix_market_out_of_range) {
+        temp_file file("out_of_range.mtx");
+        {
+            std::ofstream out(file.path);
+            out << "%%MatrixMarket matrix coordinate real general\n"
+                   "3 4 2\n"
+                   "1 1 1\n"
+                   "2 5 1\n";
+        }
+        BOOST_CHECK_THROW(matrix_market_value_generator<float>(file.path), std::runtime_error);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_binary_round_trip) {
+        for (auto layout : {binary_matrix_layout::COO, binary_matrix_layout::CSR}) {
+            temp_file file("round_trip.bin");
+            sparse_matrix_value_generator<float> reference(40, 30, 200, 11, test_factory());
+            values_t expected = drain_next(reference);
+
+            sparse_matrix_value_generator<float> source(40, 30, 200, 11, test_factory());
+            BOOST_TEST(write_binary_matrix(source, file.path, layout) == expected.size());
+
+            for (size_t batch_size : {1, 7, 1000}) {
+                binary_matrix_value_generator<float> gen(file.path);
+                BOOST_TEST(gen.height() == 40);
+                BOOST_TEST(gen.width() == 30);
+                check_same_values(drain_batches(gen, batch_size), expected);
+            }
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(test_binary_invalid_rows) {
+        temp_file file("invalid_rows.bin");
+        for (auto layout : {binary_matrix_layout::COO, binary_matrix_layout::CSR}) {
+            list_generator zero_row(3, 3, {{0, 1, 1.0f}});
+            BOOST_CHECK_THROW(write_binary_matrix(zero_row, file.path, layout), std::runtime_error);
+            list_generator high_row(3, 3, {{4, 1, 1.0f}});
+            BOOST_CHECK_THROW(write_binary_matrix(high_row, file.path, layout), std::runtime_error);
+            list_generator backwards(3, 3, {{2, 1, 1.0f}, {1, 1, 1.0f}});
+            BOOST_CHECK_THROW(write_binary_matrix(backwards, file.path, layout), std::runtime_error);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(test_binary_truncated) {
+        temp_file file("truncated.bin");
+        list_generator source(3, 3, {{1, 1, 1.0f}, {2, 3, 2.0f}, {3, 2, 3.0f}});
+        write_binary_matrix(source, file.path, binary_matrix_layout::CSR);
+        std::filesystem::resize_file(file.path, std::filesystem::file_size(file.path) - 1);
+        BOOST_CHECK_THROW(binary_matrix_value_generator<float>(file.path), std::runtime_error);
+    }
+BOOST_AUTO_TEST_SUITE_END()
@@ -10,6 +10,7 @@
 
 #include "../float_value_factory.hh"
 #include "../sparse_matrix_value_generator.hh"
+#include "../utils/query_stats.hh"
 #include "../../scylla_modern_cpp_driver/include/prepared_query.hh"
 #include "../../scylla_modern_cpp_driver/include/session.hh"
 
@@ -17,6 +18,34 @@
 namespace {
     constexpr size_t columns_in_row = 10;
 
+    /* Columns of a row (or column) part in the order in which the fetch queries select them:
+     * filled, then all index columns, then all value columns.
+     */
+    std::string selected_data_columns() {
+        std::vector<std::string> columns = {"filled"};
+        for (size_t i = 0; i < columns_in_row; i++) {
+            columns.push_back(fmt::format("i_{}", i));
+        }
+        for (size_t i = 0; i < columns_in_row; i++) {
+            columns.push_back(fmt::format("v_{}", i));
+        }
+        return fmt::format("{}", fmt::join(columns, ", "));
+    }
+
+    /* Positions of the selected data columns in fetched rows */
+    constexpr size_t filled_position = 0;
+
+    constexpr size_t index_position(size_t i) {
+        return 1 + i;
+    }
+
+    constexpr size_t value_position(size_t i) {
+        return 1 + columns_in_row + i;
+    }
+
+    /* Selected after the data columns by fetch_whole_matrix_query */
+    constexpr size_t row_position = 1 + 2 * columns_in_row;
+
 
     const std::string namespace_name = "zpp";
     const std::string table_name_rows = "lil_rows";
@@ -103,24 +132,24 @@ SELECT column FROM {0}.{1} WHERE matrix_id = ?;
 )", namespace_name, table_name_columns);
 
     const std::string matrix_fetch_row_part = fmt::format(R"(
-SELECT * FROM {0}.{1} WHERE matrix_id = ? AND row = ? AND part = ?;
-)", namespace_name, table_name_rows);
+SELECT {2} FROM {0}.{1} WHERE matrix_id = ? AND row = ? AND part = ?;
+)", namespace_name, table_name_rows, selected_data_columns());
 
     const std::string matrix_fetch_column_part = fmt::format(R"(
-SELECT * FROM {0}.{1} WHERE matrix_id = ? AND column = ? AND part = ?;
-)", namespace_name, table_name_columns);
+SELECT {2} FROM {0}.{1} WHERE matrix_id = ? AND column = ? AND part = ?;
+)", namespace_name, table_name_columns, selected_data_columns());
 
     const std::string matrix_fetch_whole_row = fmt::format(R"(
-SELECT * FROM {0}.{1} WHERE matrix_id = ? AND row = ?;
-)", namespace_name, table_name_rows);
+SELECT {2} FROM {0}.{1} WHERE matrix_id = ? AND row = ?;
+)", namespace_name, table_name_rows, selected_data_columns());
 
     const std::string matrix_fetch_whole_column = fmt::format(R"(
-SELECT * FROM {0}.{1} WHERE matrix_id = ? AND column = ?;
-)", namespace_name, table_name_columns);
+SELECT {2} FROM {0}.{1} WHERE matrix_id = ? AND column = ?;
+)", namespace_name, table_name_columns, selected_data_columns());
 
-    const std::string fetch_whole_matrix_query = R"(
-SELECT * FROM {}.{} WHERE matrix_id = ?;
-)";
+    const std::string fetch_whole_matrix_query = fmt::format(R"(
+SELECT {0}, row FROM {{}}.{{}} WHERE matrix_id = ?;
+)", selected_data_columns());
 
     const std::string fetch_matrix_info_query = fmt::format(R"(
 SELECT * FROM {}.{} WHERE matrix_id = ?;
@@ -145,7 +174,7 @@ public:
     explicit LIL(std::shared_ptr<scmd::session> conn) :
             _sess(std::move(conn)) {
         /* Make sure that the necessary namespaces and table exist */
-        _sess->execute(create_keyspace_query);
+        timed_execute(create_keyspace_query, create_keyspace_query);
 
 
         for(size_t i = 0; i < columns_in_row; i++) {
@@ -161,24 +190,24 @@ public:
             _data_columns_with_types.push_back(fmt::format("v_{} double", i));
         }
         /* ========== DROP TABLES ======= */
-        _sess->execute(fmt::format(drop_table_query, namespace_name, table_name_rows));
-        _sess->execute(fmt::format(drop_table_query, namespace_name, table_name_columns));
-        _sess->execute(fmt::format(drop_table_query, namespace_name, table_name_meta));
+        timed_execute(fmt::format(drop_table_query, namespace_name, table_name_rows), drop_table_query);
+        timed_execute(fmt::format(drop_table_query, namespace_name, table_name_columns), drop_table_query);
+        timed_execute(fmt::format(drop_table_query, namespace_name, table_name_meta), drop_table_query);
 
         /* =========== CREATE TABLES ========== */
         std::string rows_query = fmt::format(create_rows_table_query, fmt::join(_data_columns_with_types, ", "));
         //fmt::print(rows_query);
-        _sess->execute(rows_query);
+        timed_execute(rows_query, create_rows_table_query);
         std::string cols_query = fmt::format(create_columns_table_query, fmt::join(_data_columns_with_types, ", "));
         //fmt::print(cols_query);
-        _sess->execute(cols_query);
-        _sess->execute(create_meta_table_query);
+        timed_execute(cols_query, create_columns_table_query);
+        timed_execute(create_meta_table_query, create_meta_table_query);
     }
 
     std::vector<std::tuple<int32_t, int64_t, int64_t>> fetch_list() {
         std::vector<std::tuple<int32_t, int64_t, int64_t>> result;
 
-        auto list_result = _sess->execute(list_matrices_query);
+        scmd::query_result list_result = timed_execute(list_matrices_query, list_matrices_query);
 
         while(list_result.next_row()) {
             auto id = list_result.get_column<int32_t>("matrix_id");
@@ -186,6 +215,7 @@ public:
             auto height = list_result.get_column<int64_t>("height");
             result.emplace_back(id, width, height);
         }
+        record_rows(list_matrices_query, result.size(), result.size() * meta_row_bytes);
 
         return result;
     }
@@ -199,9 +229,9 @@ public:
     }
 
     void delete_matrix(int32_t id) {
-        _sess->execute(scmd::statement(fmt::format(delete_matrix_query, namespace_name, table_name_rows), 1).bind(id));
-        _sess->execute(scmd::statement(fmt::format(delete_matrix_query, namespace_name, table_name_columns), 1).bind(id));
-        _sess->execute(scmd::statement(fmt::format(delete_matrix_query, namespace_name, table_name_meta), 1).bind(id));
+        timed_execute(scmd::statement(fmt::format(delete_matrix_query, namespace_name, table_name_rows), 1).bind(id), delete_matrix_query, sizeof(id));
+        timed_execute(scmd::statement(fmt::format(delete_matrix_query, namespace_name, table_name_columns), 1).bind(id), delete_matrix_query, sizeof(id));
+        timed_execute(scmd::statement(fmt::format(delete_matrix_query, namespace_name, table_name_meta), 1).bind(id), delete_matrix_query, sizeof(id));
     }
 
     /* Multiplies two matrices loaded into Scylla with load_matrix. Returns index of new matrix */
@@ -255,23 +285,57 @@ public:
         const auto& [height, width] = get_dimensions(matrix_id);
 
         std::vector<std::vector<T>> result(height, std::vector<T>(width, 0.0));
-        auto query_result = _sess->execute(scmd::statement(fmt::format(fetch_whole_matrix_query, namespace_name, table_name_rows), 1).bind(matrix_id));
+        scmd::query_result query_result = timed_execute(scmd::statement(fmt::format(fetch_whole_matrix_query, namespace_name, table_name_rows), 1).bind(matrix_id), fetch_whole_matrix_query, sizeof(matrix_id));
 
+        size_t rows = 0, bytes = 0;
         while(query_result.next_row()) {
-            auto r_row = query_result.get_column<int64_t>("row");
-            auto filled = query_result.get_column<int32_t>("filled");
+            auto r_row = query_result.get_column<int64_t>(row_position);
+            auto filled = query_result.get_column<int32_t>(filled_position);
             for(int i = 0; i < filled; i++) {
-                auto r_column = query_result.get_column<int64_t>(_data_columns[2 * i]);
-                T r_value = query_result.get_column<double>(_data_columns[2 * i + 1]);
+                auto r_column = query_result.get_column<int64_t>(index_position(i));
+                T r_value = query_result.get_column<double>(value_position(i));
                 result[r_row - 1][r_column - 1] = r_value;
             }
+            rows++;
+            bytes += sizeof(r_row) + data_row_bytes(filled);
         }
+        record_rows(fetch_whole_matrix_query, rows, bytes);
 
         return result;
     }
 
 
 private:
+    /* Sizes of the values of a row of the meta table, and of a data row with the given number of values */
+    static constexpr size_t meta_row_bytes = sizeof(int32_t) + 2 * sizeof(int64_t);
+
+    static size_t data_row_bytes(int32_t filled) {
+        return sizeof(int32_t) + filled * (sizeof(int64_t) + sizeof(double));
+    }
+
+    /* Executes a query through the session, recording it in query_stats under the given template.
+     * request_bytes is the size of the bound values. Rows of the response are recorded with record_rows(),
+     * as they are only known once they are read.
+     */
+    template<typename Q>
+    scmd::query_result timed_execute(Q&& query, const std::string& query_template, size_t request_bytes = 0) {
+        auto& stats = query_stats::get(query_template);
+        auto start = query_stats::clock::now();
+        try {
+            auto result = _sess->execute(std::forward<Q>(query));
+            query_stats::record(stats, start, false, 0, request_bytes);
+            return result;
+        } catch (...) {
+            query_stats::record(stats, start, true, 0, request_bytes);
+            throw;
+        }
+    }
+
+    /* Records rows read from the response of a query, with the total size of their values. */
+    void record_rows(const std::string& query_template, size_t rows, size_t bytes) {
+        query_stats::add_rows(query_stats::get(query_template), rows, bytes);
+    }
+
     T multiply_single_cell(const row_data_t& row, const row_data_t& column) {
         T result = 0.0;
 
@@ -294,71 +358,86 @@ private:
         return result;
     }
 
-    row_data_t db_row_to_row_data(scmd::query_result& result) {
+    row_data_t db_row_to_row_data(scmd::query_result& result, const std::string& query_template) {
         row_data_t ret;
+        size_t rows = 0, bytes = 0;
         while(result.next_row()) {
-            auto filled = result.get_column<int32_t>("filled");
+            auto filled = result.get_column<int32_t>(filled_position);
             for(int32_t i = 0; i < filled; i++) {
-                // TODO: make sure column order is correct (in case it somehow changes in the future)
-                auto idx = result.get_column<int64_t>(4 + i);
-                T value = result.get_column<double>(4 + columns_in_row + i);
+                auto idx = result.get_column<int64_t>(index_position(i));
+                T value = result.get_column<double>(value_position(i));
                 ret.emplace_back(idx, value);
             }
+            rows++;
+            bytes += data_row_bytes(filled);
         }
+        record_rows(query_template, rows, bytes);
 
         return ret;
     }
 
     row_data_t get_row(int32_t matrix_id, int64_t row) {
-        auto result = _sess->execute(scmd::statement(matrix_fetch_whole_row, 2).bind(matrix_id, row));
-        return db_row_to_row_data(result);
+        scmd::query_result result = timed_execute(scmd::statement(matrix_fetch_whole_row, 2).bind(matrix_id, row), matrix_fetch_whole_row,
+                                                  sizeof(matrix_id) + sizeof(row));
+        return db_row_to_row_data(result, matrix_fetch_whole_row);
     }
 
     row_data_t get_column(int32_t matrix_id, int64_t column) {
-        auto result = _sess->execute(scmd::statement(matrix_fetch_whole_column, 2).bind(matrix_id, column));
-        return db_row_to_row_data(result);
+        scmd::query_result result = timed_execute(scmd::statement(matrix_fetch_whole_column, 2).bind(matrix_id, column), matrix_fetch_whole_column,
+                                                  sizeof(matrix_id) + sizeof(column));
+        return db_row_to_row_data(result, matrix_fetch_whole_column);
     }
 
     int32_t register_new_matrix(int64_t height, int64_t width) {
         int32_t new_id = get_new_matrix_id();
-        _sess->execute(scmd::statement(new_matrix_meta_query, 3).bind(new_id, height, width));
+        timed_execute(scmd::statement(new_matrix_meta_query, 3).bind(new_id, height, width), new_matrix_meta_query, meta_row_bytes);
         return new_id;
     }
 
 
     std::pair<int64_t, int64_t> get_dimensions(int32_t id) {
-        auto result = _sess->execute(scmd::statement(fetch_matrix_info_query, 1).bind(id));
+        scmd::query_result result = timed_execute(scmd::statement(fetch_matrix_info_query, 1).bind(id), fetch_matrix_info_query, sizeof(id));
         if(!result.next_row()) {
             return {0, 0};
         }
+        record_rows(fetch_matrix_info_query, 1, meta_row_bytes);
         return std::make_pair(result.get_column<int64_t>("height"), result.get_column<int64_t>("width"));
     }
 
 
     int32_t get_new_matrix_id() {
-        auto res = _sess->execute(get_max_matrix_id_query);
-        if(!res.next_row() || res.is_column_null("id")) return 0;
+        scmd::query_result res = timed_execute(get_max_matrix_id_query, get_max_matrix_id_query);
+        if(!res.next_row()) return 0;
+        bool none = res.is_column_null("id");
+        record_rows(get_max_matrix_id_query, 1, none ? 0 : sizeof(int32_t));
+        if(none) return 0;
         return res.get_column<int32_t>("id") + 1;
     }
 
     std::set<int64_t> get_row_list(int32_t matrix_id) {
-        auto query_result = _sess->execute(scmd::statement(matrix_fetch_row_list, 1).bind(matrix_id));
+        scmd::query_result query_result = timed_execute(scmd::statement(matrix_fetch_row_list, 1).bind(matrix_id), matrix_fetch_row_list, sizeof(matrix_id));
         std::set<int64_t> rows;
+        size_t read = 0;
         while(query_result.next_row()) {
             auto row_num = query_result.get_column<int64_t>("row");
             rows.insert(row_num);
+            read++;
         }
+        record_rows(matrix_fetch_row_list, read, read * sizeof(int64_t));
 
         return rows;
     }
 
     std::set<int64_t> get_column_list(int32_t matrix_id) {
-        auto query_result = _sess->execute(scmd::statement(matrix_fetch_column_list, 1).bind(matrix_id));
+        scmd::query_result query_result = timed_execute(scmd::statement(matrix_fetch_column_list, 1).bind(matrix_id), matrix_fetch_column_list, sizeof(matrix_id));
         std::set<int64_t> columns;
+        size_t read = 0;
         while(query_result.next_row()) {
             auto col_num = query_result.get_column<int64_t>("column");
             columns.insert(col_num);
+            read++;
         }
+        record_rows(matrix_fetch_column_list, read, read * sizeof(int64_t));
 
         return columns;
     }
@@ -377,7 +456,7 @@ private:
         for(auto entry : row_data) {
             stmt.bind(std::get<0>(entry), (double)std::get<1>(entry));
         }
-        _sess->execute(stmt);
+        timed_execute(stmt, matrix_insert_row_query, sizeof(matrix_id) + sizeof(row) + sizeof(part) + data_row_bytes(row_data.size()));
     }
 
     std::set<int64_t> generate_row_matrix(int32_t id, matrix_value_generator<T>&& gen) {
@@ -388,19 +467,23 @@ private:
         int64_t row = 1;
         int64_t part = 0;
 
-        while (gen.has_next()) {
-            matrix_value<T> next = gen.next();
-            columns.emplace(next.j);
-            //fmt::print(stderr, "Next cell: [{}, {}] : {}\n", next.i, next.j, next.val);
-            if(next.i != row || row_data.size() == columns_in_row) {
-                //fmt::print(stderr, "row: {}. part: {}, size: {}, next.i: {}\n", row, part, row_data.size(), next.i);
-                submit_row_data(insert_row_prepared, id, row, part, row_data);
-                row_data.clear();
-                part = (next.i == row) ? part + 1 : 0;
-                row = next.i;
+        std::vector<matrix_value<T>> batch;
+        batch.reserve(matrix_value_generator<T>::default_batch_size);
+
+        while (gen.next_batch(batch, matrix_value_generator<T>::default_batch_size) > 0) {
+            for (const matrix_value<T>& next : batch) {
+                columns.emplace(next.j);
+                //fmt::print(stderr, "Next cell: [{}, {}] : {}\n", next.i, next.j, next.val);
+                if(next.i != row || row_data.size() == columns_in_row) {
+                    //fmt::print(stderr, "row: {}. part: {}, size: {}, next.i: {}\n", row, part, row_data.size(), next.i);
+                    submit_row_data(insert_row_prepared, id, row, part, row_data);
+                    row_data.clear();
+                    part = (next.i == row) ? part + 1 : 0;
+                    row = next.i;
+                }
+                row_data.emplace_back(next.j, next.val);
             }
-            row_data.emplace_back(next.j, next.val);
-
+            batch.clear();
         }
 
         if(!row_data.empty()) {
@@ -420,34 +503,37 @@ private:
 
         for(int64_t column : columns) {
             column_info.insert({column,  {0, 0}});
-            _sess->execute(init_column_prepared.get_statement().bind(id, column, (int64_t)0));
+            timed_execute(init_column_prepared.get_statement().bind(id, column, (int64_t)0), matrix_init_column_part,
+                          sizeof(id) + sizeof(column) + sizeof(int64_t));
         }
 
         std::set<int64_t> rows = get_row_list(id);
         for(int64_t rownum : rows) {
             int64_t part = 0;
             do {
-                auto result = _sess->execute(_fetch_row_part_prepared.get_statement().bind(id, rownum, part));
-                // SELECT * FROM {0}.{1} WHERE matrix_id = ? AND row = ? AND part = ?;
+                scmd::query_result result = timed_execute(_fetch_row_part_prepared.get_statement().bind(id, rownum, part), matrix_fetch_row_part,
+                                                          sizeof(id) + sizeof(rownum) + sizeof(part));
                 if (!result.next_row()) {
                     break;
                 }
-                auto filled = result.get_column<int32_t>("filled");
+                auto filled = result.get_column<int32_t>(filled_position);
+                record_rows(matrix_fetch_row_part, 1, data_row_bytes(filled));
                 for (int i = 0; i < filled; i++) {
-                    // TODO: make sure column order is correct (in case it somehow changes in the future)
-                    auto column = result.get_column<int64_t>(4 + i);
-                    T value = result.get_column<double>(4 + columns_in_row + i);
+                    auto column = result.get_column<int64_t>(index_position(i));
+                    T value = result.get_column<double>(value_position(i));
                     auto info = column_info.find(column);
                     if(info->second.second == columns_in_row) {
                         info->second.first++;
                         info->second.second = 0;
-                        _sess->execute(init_column_prepared.get_statement().bind(id, column, info->second.first));
+                        timed_execute(init_column_prepared.get_statement().bind(id, column, info->second.first), matrix_init_column_part,
+                                      sizeof(id) + sizeof(column) + sizeof(info->second.first));
                     }
                     int32_t idx = info->second.second;
                     std::string stmt_str = fmt::format(matrix_append_to_column, _data_columns[2 * idx], _data_columns[2 * idx + 1]);
                     //fmt::print(stmt_str);
                     info->second.second++;
-                    _sess->execute(scmd::statement(stmt_str, 6).bind(info->second.second, rownum, (double)value, id, column, info->second.first));
+                    timed_execute(scmd::statement(stmt_str, 6).bind(info->second.second, rownum, (double)value, id, column, info->second.first), matrix_append_to_column,
+                                  sizeof(int32_t) + sizeof(rownum) + sizeof(double) + sizeof(id) + sizeof(column) + sizeof(int64_t));
                 }
                 part++;
             } while (true);
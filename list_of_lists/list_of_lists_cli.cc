@@ -62,4 +62,6 @@ int main(int argc, char *argv[]) {
 
     }
 
+    query_stats::dump_json(std::cerr);
+
 }
\ No newline at end of file
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "matrix_value_generator.hh"
+#include "sparse_matrix_value_generator.hh"
+
+/* Streams a Matrix Market coordinate file (real, integer or pattern; general, symmetric
+ * or skew-symmetric) in the row-major order expected by the loaders.
+ *
+ * Entries are read in chunks of at most max_values_in_memory values. Every chunk is sorted
+ * and, if the file does not fit in one chunk, spilled to a temporary run file.
+ * The runs are then merged while iterating, so memory use stays bounded by the chunk size
+ * plus one read buffer per run.
+ */
+template <class V>
+class matrix_market_value_generator : public matrix_value_generator<V> {
+private:
+    struct entry {
+        uint64_t i, j;
+        V val;
+
+        bool operator<(const entry& other) const {
+            return i < other.i || (i == other.i && j < other.j);
+        }
+    };
+
+    /* Sequential reader of one sorted run file */
+    struct run_reader {
+        static constexpr size_t buffer_entries = 4096;
+
+        std::ifstream in;
+        std::vector<entry> buffer;
+        size_t pos = 0;
+
+        explicit run_reader(const std::filesystem::path& path) : in(path, std::ios::binary) {
+            refill();
+        }
+
+        void refill() {
+            buffer.resize(buffer_entries);
+            in.read(reinterpret_cast<char*>(buffer.data()), buffer_entries * sizeof(entry));
+            buffer.resize(in.gcount() / sizeof(entry));
+            pos = 0;
+        }
+
+        bool empty() const {
+            return pos == buffer.size();
+        }
+
+        const entry& front() const {
+            return buffer[pos];
+        }
+
+        void pop() {
+            if (++pos == buffer.size()) {
+                refill();
+            }
+        }
+    };
+
+    struct run_order {
+        const std::vector<std::unique_ptr<run_reader>>* runs;
+
+        bool operator()(size_t a, size_t b) const {
+            return (*runs)[b]->front() < (*runs)[a]->front();
+        }
+    };
+
+    enum class symmetry { general, symmetric, skew_symmetric };
+
+    size_t _height, _width;
+    size_t _max_values_in_memory;
+    std::filesystem::path _temp_dir;
+
+    /* In-memory sorted chunk, used when the whole file fits in memory */
+    std::vector<entry> _chunk;
+    size_t _chunk_pos;
+
+    std::vector<std::filesystem::path> _run_paths;
+    std::vector<std::unique_ptr<run_reader>> _runs;
+    std::priority_queue<size_t, std::vector<size_t>, run_order> _merge_queue;
+
+    void _spill_chunk() {
+        std::sort(_chunk.begin(), _chunk.end());
+
+        std::ostringstream name;
+        name << "matrix_market_run_" << reinterpret_cast<uintptr_t>(this) << "_" << _run_paths.size() << ".bin";
+        auto path = _temp_dir / name.str();
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(_chunk.data()), _chunk.size() * sizeof(entry));
+        if (!out) {
+            throw std::runtime_error("Cannot write run file " + path.string());
+        }
+        _run_paths.push_back(path);
+        _chunk.clear();
+    }
+
+    void _add(uint64_t i, uint64_t j, V val) {
+        _chunk.push_back({i, j, val});
+        if (_chunk.size() >= _max_values_in_memory) {
+            _spill_chunk();
+        }
+    }
+
+    void _read(std::istream& in) {
+        std::string line;
+        if (!std::getline(in, line)) {
+            throw std::runtime_error("Empty Matrix Market file");
+        }
+
+        std::istringstream banner(line);
+        std::string tag, object, format, field, sym;
+        banner >> tag >> object >> format >> field >> sym;
+        std::transform(format.begin(), format.end(), format.begin(), ::tolower);
+        std::transform(field.begin(), field.end(), field.begin(), ::tolower);
+        std::transform(sym.begin(), sym.end(), sym.begin(), ::tolower);
+
+        if (tag != "%%MatrixMarket" || format != "coordinate") {
+            throw std::runtime_error("Only Matrix Market coordinate files are supported");
+        }
+        if (field != "real" && field != "integer" && field != "pattern" && field != "double") {
+            throw std::runtime_error("Unsupported Matrix Market field: " + field);
+        }
+        bool pattern = field == "pattern";
+        symmetry kind = symmetry::general;
+        if (sym == "symmetric") {
+            kind = symmetry::symmetric;
+        } else if (sym == "skew-symmetric") {
+            kind = symmetry::skew_symmetric;
+        } else if (sym != "general") {
+            throw std::runtime_error("Unsupported Matrix Market symmetry: " + sym);
+        }
+
+        while (std::getline(in, line) && (line.empty() || line[0] == '%'));
+        size_t entries;
+        std::istringstream size_line(line);
+        if (!(size_line >> _height >> _width >> entries)) {
+            throw std::runtime_error("Malformed Matrix Market size line");
+        }
+
+        for (size_t k = 0; k < entries; k++) {
+            uint64_t i, j;
+            double val = 1;
+            if (!(in >> i >> j) || (!pattern && !(in >> val))) {
+                throw std::runtime_error("Matrix Market file ended after " + std::to_string(k) + " entries");
+            }
+            bool mirrored = kind != symmetry::general && i != j;
+            if (i < 1 || i > _height || j < 1 || j > _width || (mirrored && (j > _height || i > _width))) {
+                throw std::runtime_error("Matrix Market entry " + std::to_string(k + 1) + " at (" + std::to_string(i)
+                                         + ", " + std::to_string(j) + ") out of range of a " + std::to_string(_height)
+                                         + "x" + std::to_string(_width) + " matrix");
+            }
+            if (val == 0) {
+                continue;
+            }
+
+            _add(i, j, static_cast<V>(val));
+            if (mirrored) {
+                _add(j, i, static_cast<V>(kind == symmetry::skew_symmetric ? -val : val));
+            }
+        }
+    }
+
+    entry _take() {
+        if (_merge_queue.empty()) {
+            return _chunk[_chunk_pos++];
+        }
+
+        size_t run = _merge_queue.top();
+        _merge_queue.pop();
+        entry e = _runs[run]->front();
+        _runs[run]->pop();
+        if (!_runs[run]->empty()) {
+            _merge_queue.push(run);
+        }
+        return e;
+    }
+
+public:
+    matrix_market_value_generator(const std::string& path, size_t max_values_in_memory = 1 << 22,
+                                  std::filesystem::path temp_dir = std::filesystem::temp_directory_path())
+            : _height(0), _width(0), _max_values_in_memory(std::max<size_t>(max_values_in_memory, 1)),
+              _temp_dir(std::move(temp_dir)), _chunk_pos(0), _merge_queue(run_order{&_runs}) {
+        std::ifstream in(path);
+        if (!in) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        _read(in);
+
+        if (_run_paths.empty()) {
+            std::sort(_chunk.begin(), _chunk.end());
+            return;
+        }
+
+        if (!_chunk.empty()) {
+            _spill_chunk();
+        }
+        _chunk.shrink_to_fit();
+        for (auto& run_path : _run_paths) {
+            _runs.push_back(std::make_unique<run_reader>(run_path));
+            if (!_runs.back()->empty()) {
+                _merge_queue.push(_runs.size() - 1);
+            }
+        }
+    }
+
+    matrix_market_value_generator(const matrix_market_value_generator&) = delete;
+    matrix_market_value_generator& operator=(const matrix_market_value_generator&) = delete;
+
+    ~matrix_market_value_generator() {
+        _runs.clear();
+        for (auto& run_path : _run_paths) {
+            std::error_code ignored;
+            std::filesystem::remove(run_path, ignored);
+        }
+    }
+
+    bool has_next() {
+        return _chunk_pos < _chunk.size() || !_merge_queue.empty();
+    }
+
+    matrix_value<V> next() {
+        if (!has_next()) {
+            throw no_next_value_exception();
+        }
+        entry e = _take();
+        return matrix_value<V>(e.i, e.j, e.val);
+    }
+
+    size_t next_batch(std::vector<matrix_value<V>>& out, size_t max_count) override {
+        size_t appended = 0;
+        while (appended < max_count && has_next()) {
+            entry e = _take();
+            out.emplace_back(e.i, e.j, e.val);
+            appended++;
+        }
+        return appended;
+    }
+
+    size_t height() {
+        return _height;
+    }
+
+    size_t width() {
+        return _width;
+    }
+};
@@ -1,7 +1,22 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
+
 template<class V>
 class matrix_value_factory {
 public:
     virtual V next() = 0;
+
+    /* Writes the next count values to out. Yields the same values as count calls to next(). */
+    virtual void fill(V* out, size_t count) {
+        for (size_t k = 0; k < count; k++) {
+            out[k] = next();
+        }
+    }
+
+    /* Creates an independent factory drawing from the same distribution with a different seed. */
+    virtual std::shared_ptr<matrix_value_factory<V>> fork(int seed) const = 0;
+
+    virtual ~matrix_value_factory() {};
 };
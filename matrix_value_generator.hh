@@ -1,15 +1,31 @@
 #pragma once
 
+#include <vector>
 #include "matrix_value.hh"
 
 template<class V>
 class matrix_value_generator {
 public:
+    /* Number of values loaders request from next_batch at once. */
+    static constexpr size_t default_batch_size = 4096;
 
     virtual bool has_next() = 0;
 
     virtual matrix_value<V> next() = 0;
 
+    /* Appends at most max_count next values to out and returns how many were appended.
+     * Returns 0 only if the generator is exhausted. Generators should override this
+     * with a fast path that avoids calling has_next()/next() per value.
+     */
+    virtual size_t next_batch(std::vector<matrix_value<V>>& out, size_t max_count) {
+        size_t appended = 0;
+        while (appended < max_count && has_next()) {
+            out.push_back(next());
+            appended++;
+        }
+        return appended;
+    }
+
     virtual size_t height() = 0;
 
     virtual size_t width() = 0;
@@ -7,6 +7,7 @@
 
 #include "matrix_value_generator.hh"
 #include <utility>
+#include <vector>
 
 /* Abstract API for specialized matrix multiplicators. */
 template<typename T>
@@ -22,6 +23,18 @@ public:
     /* Obtains the value in the multiplication result at (x; y) = (pos.first; pos.second) */
     virtual T get_result(std::pair<size_t, size_t> pos) = 0;
 
+    /* Obtains the values in the multiplication result at every position, in the same order.
+     * Implementations storing the result in larger units should override it to read every unit once.
+     */
+    virtual std::vector<T> get_results(const std::vector<std::pair<size_t, size_t>>& positions) {
+        std::vector<T> ret;
+        ret.reserve(positions.size());
+        for (auto& pos : positions) {
+            ret.push_back(get_result(pos));
+        }
+        return ret;
+    }
+
     virtual ~multiplicator() {};
 };
 
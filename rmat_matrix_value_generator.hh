@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+#include "matrix_value_generator.hh"
+#include "matrix_value_factory.hh"
+#include "sparse_matrix_value_generator.hh"
+
+/* Generates a power-law (R-MAT) sparsity pattern: each nonzero is placed by recursively
+ * choosing one of the four quadrants of the matrix with probabilities a, b, c and 1 - a - b - c.
+ * Row lengths and column popularity end up heavily skewed, as in real-world graphs.
+ *
+ * Positions are sampled up front, deduplicated and sorted to keep row-major order,
+ * so memory use is O(number of values). Values are drawn from the factory while iterating.
+ */
+template <class V>
+class rmat_matrix_value_generator : public matrix_value_generator<V> {
+private:
+    /* Rounds of resampling used to replace duplicated positions */
+    static constexpr int _max_rounds = 16;
+
+    size_t _width, _height;
+    std::shared_ptr<matrix_value_factory<V>> _matrix_value_factory;
+    std::vector<std::pair<size_t, size_t>> _positions;
+    size_t _next_idx;
+    std::vector<V> _values;
+
+    std::pair<size_t, size_t> _sample_position(std::mt19937_64& rng, double a, double b, double c, int levels) {
+        std::uniform_real_distribution<double> _dist(0.0, 1.0);
+        while (true) {
+            size_t i = 0, j = 0;
+            for (int level = 0; level < levels; level++) {
+                double p = _dist(rng);
+                i <<= 1;
+                j <<= 1;
+                if (p < a) {
+                    /* top-left quadrant */
+                } else if (p < a + b) {
+                    j |= 1;
+                } else if (p < a + b + c) {
+                    i |= 1;
+                } else {
+                    i |= 1;
+                    j |= 1;
+                }
+            }
+            if (i < _height && j < _width) {
+                return {i + 1, j + 1};
+            }
+        }
+    }
+
+public:
+    rmat_matrix_value_generator(size_t height, size_t width, size_t suggested_number_of_values, int seed,
+                                std::shared_ptr<matrix_value_factory<V>> matrix_value_factory,
+                                double a = 0.57, double b = 0.19, double c = 0.19)
+            : _width(width), _height(height), _matrix_value_factory(std::move(matrix_value_factory)), _next_idx(0) {
+        if (height == 0 || width == 0) {
+            return;
+        }
+
+        int levels = 0;
+        while ((size_t(1) << levels) < std::max(height, width)) {
+            levels++;
+        }
+
+        size_t target = std::min(suggested_number_of_values, height * width);
+        std::mt19937_64 rng(seed);
+        _positions.reserve(target);
+
+        for (int round = 0; round < _max_rounds && _positions.size() < target; round++) {
+            size_t missing = target - _positions.size();
+            for (size_t k = 0; k < missing; k++) {
+                _positions.push_back(_sample_position(rng, a, b, c, levels));
+            }
+            std::sort(_positions.begin(), _positions.end());
+            _positions.erase(std::unique(_positions.begin(), _positions.end()), _positions.end());
+        }
+    }
+
+    bool has_next() {
+        return _next_idx < _positions.size();
+    }
+
+    matrix_value<V> next() {
+        if (!has_next()) {
+            throw no_next_value_exception();
+        }
+        auto [i, j] = _positions[_next_idx++];
+        return matrix_value<V>(i, j, _matrix_value_factory->next());
+    }
+
+    size_t next_batch(std::vector<matrix_value<V>>& out, size_t max_count) override {
+        size_t appended = std::min(max_count, _positions.size() - _next_idx);
+        _values.resize(appended);
+        _matrix_value_factory->fill(_values.data(), appended);
+        for (size_t k = 0; k < appended; k++) {
+            auto [i, j] = _positions[_next_idx++];
+            out.emplace_back(i, j, _values[k]);
+        }
+        return appended;
+    }
+
+    size_t height() {
+        return this->_height;
+    }
+
+    size_t width() {
+        return this->_width;
+    }
+};
@@ -8,6 +8,7 @@
 #include "dictionary_of_keys/dictionary_of_keys.hh"
 #include "../scylla_modern_cpp_driver/include/session.hh"
 #include "list_of_lists/list_of_lists_wrapper.hh"
+#include "utils/query_stats.hh"
 
 #define BOOST_TEST_MAIN
 #define BOOST_TEST_MODULE simple_test
@@ -33,12 +34,17 @@ std::list<matrix_value<float>> get_multiplied_vals(size_t dimension, size_t vals
 
     std::list<matrix_value<float>> ret;
 
+    std::vector<std::pair<size_t, size_t>> positions;
     for (int i = 1; i <= dimension; i++) {
         for (int j = 1; j <= dimension; j++) {
-            auto result = multiplicator->get_result({i, j});
-            if (result != 0) {
-                ret.emplace_back(i, j, result);
-            }
+            positions.emplace_back(i, j);
+        }
+    }
+
+    auto results = multiplicator->get_results(positions);
+    for (size_t k = 0; k < positions.size(); k++) {
+        if (results[k] != 0) {
+            ret.emplace_back(positions[k].first, positions[k].second, results[k]);
         }
     }
 
@@ -69,6 +75,18 @@ std::list<matrix_value<float>> get_result(implementation from, size_t dimension,
 }
 BOOST_TEST_SPECIALIZED_COLLECTION_COMPARE(std::list<matrix_value<float>>)
 
+/* Writes out the query and cache statistics of the whole run */
+struct run_statistics {
+    run_statistics() {
+        query_stats::set_count_result_bytes(true);
+    }
+
+    ~run_statistics() {
+        query_stats::dump_json(std::cerr);
+    }
+};
+BOOST_GLOBAL_FIXTURE(run_statistics);
+
 BOOST_AUTO_TEST_SUITE(simple_cross_antitest)
     BOOST_AUTO_TEST_CASE(test_fail) {
         std::shared_ptr<connector> conn = std::make_shared<connector>(IP_ADDRESS);
@@ -2,6 +2,7 @@
 
 #include <random>
 #include <memory>
+#include <vector>
 #include "matrix_value_generator.hh"
 #include "matrix_value_factory.hh"
 #include "utils/int_math.hh"
@@ -20,6 +21,7 @@ private:
     std::mt19937 _rng;
     std::shared_ptr<matrix_value_factory<V>> _matrix_value_factory;
     size_t _last_pos, _next_pos, _currently_generated;
+    std::vector<V> _values;
 
     void _calc_next_pos() {
         size_t _max_pos = height() * width();
@@ -58,6 +60,27 @@ public:
         return matrix_value(IntMath::floor_div(_last_pos, width()), 1 + (_last_pos - 1) % width(), _matrix_value_factory->next());
     }
 
+    size_t next_batch(std::vector<matrix_value<V>>& out, size_t max_count) override {
+        size_t max_pos = _height * _width;
+        size_t first = out.size();
+        while (out.size() - first < max_count && _next_pos <= max_pos && _currently_generated < _suggested_max) {
+            _currently_generated++;
+            _last_pos = _next_pos;
+            if (_currently_generated < _suggested_max) {
+                _calc_next_pos();
+            }
+            out.emplace_back(IntMath::floor_div(_last_pos, _width), 1 + (_last_pos - 1) % _width, V());
+        }
+
+        size_t appended = out.size() - first;
+        _values.resize(appended);
+        _matrix_value_factory->fill(_values.data(), appended);
+        for (size_t k = 0; k < appended; k++) {
+            out[first + k].val = _values[k];
+        }
+        return appended;
+    }
+
     size_t height() {
         return this->_height;
     }
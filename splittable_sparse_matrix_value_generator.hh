@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+#include "matrix_value_generator.hh"
+#include "matrix_value_factory.hh"
+#include "sparse_matrix_value_generator.hh"
+#include "utils/splitmix64.hh"
+
+/* Sparse matrix generator that can be split into independent row ranges.
+ *
+ * Rows are grouped into streams of rows_per_stream consecutive rows. Every stream
+ * derives its own position RNG and value factory from (seed, stream index) and gets
+ * a fixed share of the suggested number of values, so the values generated for
+ * a row never depend on where the generation started. Hence the union of values
+ * produced by any split of the row range is identical for a given seed.
+ */
+template <class V>
+class splittable_sparse_matrix_value_generator : public matrix_value_generator<V> {
+private:
+    size_t _width, _height;
+    size_t _suggested_max;
+    uint64_t _seed;
+    size_t _rows_per_stream;
+    size_t _row_begin, _row_end;
+    std::shared_ptr<matrix_value_factory<V>> _prototype_factory;
+
+    /* State of the currently generated stream. Positions are 1-based within the stream. */
+    size_t _stream, _stream_first_row, _stream_cells, _stream_quota, _stream_generated;
+    size_t _last_pos, _next_pos;
+    splitmix64 _rng;
+    std::shared_ptr<matrix_value_factory<V>> _matrix_value_factory;
+    /* Buffer for values drawn in bulk by next_batch */
+    std::vector<V> _values;
+
+    /* floor(max_values * rows / height) without overflowing for huge matrices */
+    size_t _values_up_to_row(size_t rows) const {
+        size_t max_values = std::min(_suggested_max, _height * _width);
+        return (max_values / _height) * rows + (max_values % _height) * rows / _height;
+    }
+
+    void _open_stream(size_t stream) {
+        _stream = stream;
+        _stream_first_row = stream * _rows_per_stream + 1;
+        size_t stream_last_row = std::min(_stream_first_row + _rows_per_stream - 1, _height);
+        _stream_cells = (stream_last_row - _stream_first_row + 1) * _width;
+        _stream_quota = _values_up_to_row(stream_last_row) - _values_up_to_row(_stream_first_row - 1);
+        _stream_generated = 0;
+
+        uint64_t stream_seed = splitmix64::mix(_seed ^ splitmix64::mix(stream));
+        _rng = splitmix64(stream_seed);
+        _matrix_value_factory = _prototype_factory->fork(static_cast<int>(stream_seed));
+
+        _last_pos = 0;
+        _calc_next_pos();
+    }
+
+    void _calc_next_pos() {
+        if (_stream_generated >= _stream_quota) {
+            _next_pos = _stream_cells + 1;
+            return;
+        }
+        std::uniform_int_distribution<size_t>
+                _dist(1, 1 + 2 * (_stream_cells - _last_pos) / (_stream_quota - _stream_generated));
+        _next_pos = _last_pos + _dist(_rng);
+    }
+
+    size_t _next_row() const {
+        return _stream_first_row + (_next_pos - 1) / _width;
+    }
+
+    /* Skips exhausted streams as long as they start inside the row range. */
+    void _settle() {
+        while (_next_pos > _stream_cells && (_stream + 1) * _rows_per_stream + 1 < _row_end) {
+            _open_stream(_stream + 1);
+        }
+    }
+
+    /* Advances to the position following _next_pos within the current stream. */
+    void _advance() {
+        _stream_generated++;
+        _last_pos = _next_pos;
+        _calc_next_pos();
+    }
+
+    /* Returns the value at _next_pos and advances to the following one. */
+    matrix_value<V> _take() {
+        matrix_value<V> ret(_next_row(), 1 + (_next_pos - 1) % _width, _matrix_value_factory->next());
+        _advance();
+        _settle();
+        return ret;
+    }
+
+    /* Draws the values of out[first..] from the factory of the current stream in one call. */
+    void _fill_values(std::vector<matrix_value<V>>& out, size_t first) {
+        size_t count = out.size() - first;
+        _values.resize(count);
+        _matrix_value_factory->fill(_values.data(), count);
+        for (size_t k = 0; k < count; k++) {
+            out[first + k].val = _values[k];
+        }
+    }
+
+public:
+    /* Generates rows [row_begin; row_end) of a height x width matrix.
+     * By default the whole matrix is generated.
+     */
+    splittable_sparse_matrix_value_generator(size_t height, size_t width, size_t suggested_number_of_values,
+                                             int seed, std::shared_ptr<matrix_value_factory<V>> matrix_value_factory,
+                                             size_t rows_per_stream = 64, size_t row_begin = 1, size_t row_end = 0)
+            : _width(width), _height(height), _suggested_max(suggested_number_of_values), _seed(seed),
+              _rows_per_stream(rows_per_stream), _row_begin(row_begin), _row_end(row_end == 0 ? height + 1 : row_end),
+              _prototype_factory(std::move(matrix_value_factory)),
+              _stream(0), _stream_first_row(_row_begin), _stream_cells(0), _stream_quota(0), _stream_generated(0),
+              _last_pos(0), _next_pos(1) {
+        if (_row_begin >= _row_end) {
+            return;
+        }
+
+        _open_stream((_row_begin - 1) / _rows_per_stream);
+        _settle();
+
+        /* Seek: values of the first stream above row_begin still have to be drawn
+         * to keep the remaining ones identical to an unsplit generator.
+         */
+        while (_next_pos <= _stream_cells && _next_row() < _row_begin) {
+            _take();
+        }
+    }
+
+    /* Splits the row range of this generator into the given number of parts.
+     * Part boundaries are multiples of row_alignment (counting from row 1), which
+     * lets loaders require that no storage block is shared between two parts.
+     * The parts start from scratch, regardless of values already taken from this generator.
+     */
+    std::vector<splittable_sparse_matrix_value_generator<V>> split(size_t parts, size_t row_alignment = 1) const {
+        std::vector<splittable_sparse_matrix_value_generator<V>> ret;
+        size_t rows = _row_end - _row_begin;
+        size_t part_begin = _row_begin;
+
+        for (size_t k = 1; k <= parts; k++) {
+            size_t part_end = _row_end;
+            if (k < parts) {
+                part_end = _row_begin + rows * k / parts;
+                part_end = std::max(part_begin, (part_end - 1) / row_alignment * row_alignment + 1);
+            }
+            ret.emplace_back(_height, _width, _suggested_max, static_cast<int>(_seed), _prototype_factory,
+                             _rows_per_stream, part_begin, part_end);
+            part_begin = part_end;
+        }
+
+        return ret;
+    }
+
+    bool has_next() {
+        return _next_pos <= _stream_cells && _next_row() < _row_end;
+    }
+
+    matrix_value<V> next() {
+        if (!has_next()) {
+            throw no_next_value_exception();
+        }
+        return _take();
+    }
+
+    size_t next_batch(std::vector<matrix_value<V>>& out, size_t max_count) override {
+        size_t first = out.size();
+        /* Values are drawn per stream, since every stream has its own factory */
+        size_t stream_first = first;
+        while (out.size() - first < max_count && has_next()) {
+            out.emplace_back(_next_row(), 1 + (_next_pos - 1) % _width, V());
+            _advance();
+            if (_next_pos > _stream_cells) {
+                _fill_values(out, stream_first);
+                stream_first = out.size();
+                _settle();
+            }
+        }
+        _fill_values(out, stream_first);
+        return out.size() - first;
+    }
+
+    /* First row generated by this generator */
+    size_t row_begin() {
+        return _row_begin;
+    }
+
+    /* Row after the last one generated by this generator */
+    size_t row_end() {
+        return _row_end;
+    }
+
+    size_t height() {
+        return this->_height;
+    }
+
+    size_t width() {
+        return this->_width;
+    }
+};
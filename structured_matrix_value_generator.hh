@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <random>
+#include <memory>
+#include <utility>
+#include "matrix_value_generator.hh"
+#include "matrix_value_factory.hh"
+#include "sparse_matrix_value_generator.hh"
+
+/* Base for generators whose nonzeros may only appear in a contiguous range of columns
+ * in every row (bands, blocks on the diagonal, ...).
+ * Cells allowed by the structure are numbered row by row and sampled with the same
+ * uniform-gap strategy as sparse_matrix_value_generator, so the values come out in row-major order.
+ * Derived classes implement row_columns() and call start() at the end of their constructor.
+ */
+template <class V>
+class structured_matrix_value_generator : public matrix_value_generator<V> {
+private:
+    size_t _width, _height;
+    size_t _suggested_max;
+    std::mt19937 _rng;
+    std::shared_ptr<matrix_value_factory<V>> _matrix_value_factory;
+    size_t _max_pos, _last_pos, _next_pos, _currently_generated;
+
+    /* Row containing _next_pos, number of cells in rows before it and its columns */
+    size_t _row, _cells_before_row;
+    std::pair<size_t, size_t> _row_range;
+    std::vector<V> _values;
+
+    void _calc_next_pos() {
+        std::uniform_int_distribution<size_t>
+                _dist(1, 1 + 2 * (_max_pos - _last_pos) / (_suggested_max - _currently_generated));
+        _next_pos = _last_pos + _dist(_rng);
+    }
+
+    /* Moves the row cursor forward to the row containing _next_pos. */
+    void _seek_row() {
+        while (_row <= _height && _next_pos > _cells_before_row + (_row_range.second - _row_range.first)) {
+            _cells_before_row += _row_range.second - _row_range.first;
+            _row++;
+            if (_row <= _height) {
+                _row_range = row_columns(_row);
+            }
+        }
+    }
+
+    /* Returns the value at _next_pos, without drawing its value, and advances to the following one. */
+    matrix_value<V> _take_position() {
+        _currently_generated++;
+        _last_pos = _next_pos;
+        matrix_value<V> ret(_row, _row_range.first + (_last_pos - _cells_before_row - 1), V());
+        if (_currently_generated < _suggested_max) {
+            _calc_next_pos();
+            _seek_row();
+        }
+        return ret;
+    }
+
+protected:
+    /* Columns [first; second) of the given row that may hold nonzeros. Empty ranges are allowed. */
+    virtual std::pair<size_t, size_t> row_columns(size_t row) = 0;
+
+    /* Clamps a range of columns to [1; width] */
+    std::pair<size_t, size_t> clamp_columns(long long first, long long last) {
+        first = std::max(first, 1LL);
+        last = std::min(last, static_cast<long long>(_width) + 1);
+        if (first >= last) {
+            return {1, 1};
+        }
+        return {first, last};
+    }
+
+    structured_matrix_value_generator(size_t height, size_t width, size_t suggested_number_of_values,
+                                      int seed, std::shared_ptr<matrix_value_factory<V>> matrix_value_factory)
+            : _width(width), _height(height), _suggested_max(suggested_number_of_values), _rng(seed),
+              _matrix_value_factory(std::move(matrix_value_factory)),
+              _max_pos(0), _last_pos(0), _next_pos(1), _currently_generated(0),
+              _row(1), _cells_before_row(0), _row_range(1, 1) {}
+
+    /* Counts the cells allowed by the structure and draws the first position. */
+    void start() {
+        for (size_t row = 1; row <= _height; row++) {
+            auto range = row_columns(row);
+            _max_pos += range.second - range.first;
+        }
+        if (_suggested_max == 0 || _height == 0) {
+            _next_pos = _max_pos + 1;
+            return;
+        }
+
+        _row_range = row_columns(1);
+        _calc_next_pos();
+        _seek_row();
+    }
+
+public:
+    bool has_next() {
+        return _next_pos <= _max_pos && _currently_generated < _suggested_max;
+    }
+
+    matrix_value<V> next() {
+        if (!has_next()) {
+            throw no_next_value_exception();
+        }
+        matrix_value<V> ret = _take_position();
+        ret.val = _matrix_value_factory->next();
+        return ret;
+    }
+
+    size_t next_batch(std::vector<matrix_value<V>>& out, size_t max_count) override {
+        size_t first = out.size();
+        while (out.size() - first < max_count && has_next()) {
+            out.push_back(_take_position());
+        }
+
+        size_t appended = out.size() - first;
+        _values.resize(appended);
+        _matrix_value_factory->fill(_values.data(), appended);
+        for (size_t k = 0; k < appended; k++) {
+            out[first + k].val = _values[k];
+        }
+        return appended;
+    }
+
+    size_t height() {
+        return this->_height;
+    }
+
+    size_t width() {
+        return this->_width;
+    }
+};
@@ -0,0 +1,100 @@
+#include <stdexcept>
+#include <string>
+
+#include "async_executor.hh"
+
+namespace {
+    struct pending_request {
+        query_stats::entry* stats;
+        query_stats::clock::time_point start;
+        size_t bytes;
+    };
+
+    /* Runs on a driver thread as soon as the request completes */
+    void record_completion(CassFuture* future, void* data) {
+        auto* pending = static_cast<pending_request*>(data);
+        query_stats::record(*pending->stats, pending->start, cass_future_error_code(future) != CASS_OK,
+                            0, pending->bytes);
+        delete pending;
+    }
+
+    void record_on_completion(CassFuture* future, query_stats::entry* stats,
+                              query_stats::clock::time_point start, size_t bytes) {
+        if (stats == nullptr) return;
+
+        auto* pending = new pending_request{stats, start, bytes};
+        if (cass_future_set_callback(future, record_completion, pending) != CASS_OK) {
+            delete pending;
+        }
+    }
+}
+
+async_executor::async_executor(std::shared_ptr<connector> conn, size_t max_in_flight)
+        : _conn(std::move(conn)), _max_in_flight(max_in_flight == 0 ? 1 : max_in_flight) {}
+
+void async_executor::wait_oldest() {
+    CassFuture* future = _in_flight.front();
+    _in_flight.pop_front();
+
+    if (cass_future_error_code(future) != CASS_OK) {
+        const char* message;
+        size_t message_length;
+        cass_future_error_message(future, &message, &message_length);
+        std::string error(message, message_length);
+        cass_future_free(future);
+        throw std::runtime_error("Query error: " + error);
+    }
+    cass_future_free(future);
+}
+
+void async_executor::reap_completed() {
+    while (!_in_flight.empty() && cass_future_ready(_in_flight.front())) {
+        wait_oldest();
+    }
+}
+
+void async_executor::track(CassFuture* future) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _in_flight.push_back(future);
+
+    reap_completed();
+    while (_in_flight.size() > _max_in_flight) {
+        wait_oldest();
+    }
+}
+
+void async_executor::execute(CassStatement* statement, query_stats::entry* stats, size_t bytes) {
+    auto start = query_stats::clock::now();
+    CassFuture* future = cass_session_execute(_conn->get_session(), statement);
+    record_on_completion(future, stats, start, bytes);
+    cass_statement_free(statement);
+    track(future);
+}
+
+void async_executor::execute(CassBatch* batch, query_stats::entry* stats, size_t bytes) {
+    auto start = query_stats::clock::now();
+    CassFuture* future = cass_session_execute_batch(_conn->get_session(), batch);
+    record_on_completion(future, stats, start, bytes);
+    cass_batch_free(batch);
+    track(future);
+}
+
+void async_executor::flush() {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    while (!_in_flight.empty()) {
+        wait_oldest();
+    }
+}
+
+size_t async_executor::max_in_flight() const {
+    return _max_in_flight;
+}
+
+async_executor::~async_executor() {
+    for (CassFuture* future : _in_flight) {
+        cass_future_wait(future);
+        cass_future_free(future);
+    }
+}
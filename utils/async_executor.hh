@@ -0,0 +1,52 @@
+#ifndef SCYLLA_MATRIX_TEST_ASYNC_EXECUTOR_HH
+#define SCYLLA_MATRIX_TEST_ASYNC_EXECUTOR_HH
+
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "connector.hh"
+#include "query_stats.hh"
+
+/* Pipelines statements over a connection, keeping at most max_in_flight of them
+ * executing at once. Submitting blocks only when the window is full.
+ * A failed request is reported by throwing from the call that observes it:
+ * a later execute() or flush(). Safe to use from multiple threads.
+ */
+class async_executor {
+    std::shared_ptr<connector> _conn;
+    size_t _max_in_flight;
+    std::deque<CassFuture*> _in_flight;
+    std::mutex _mutex;
+
+    /* Frees the oldest request, throwing if it failed. Blocks until it is done. */
+    void wait_oldest();
+
+    /* Frees already completed requests from the front of the window. */
+    void reap_completed();
+
+    /* Adds a started request to the window, waiting while the window is overfull. */
+    void track(CassFuture* future);
+
+public:
+    static constexpr size_t default_max_in_flight = 256;
+
+    explicit async_executor(std::shared_ptr<connector> conn, size_t max_in_flight = default_max_in_flight);
+
+    /* Starts executing the statement and takes ownership of it.
+     * If stats is given, the request is recorded there when it completes.
+     */
+    void execute(CassStatement* statement, query_stats::entry* stats = nullptr, size_t bytes = 0);
+
+    /* Starts executing the batch and takes ownership of it. */
+    void execute(CassBatch* batch, query_stats::entry* stats = nullptr, size_t bytes = 0);
+
+    /* Waits for all requests in flight. Throws if any of them failed. */
+    void flush();
+
+    size_t max_in_flight() const;
+
+    ~async_executor();
+};
+
+#endif //SCYLLA_MATRIX_TEST_ASYNC_EXECUTOR_HH
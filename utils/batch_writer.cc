@@ -0,0 +1,63 @@
+#include "batch_writer.hh"
+
+batch_writer::batch_writer(async_executor& executor, size_t batch_size)
+        : _executor(executor), _batch_size(batch_size == 0 ? 1 : batch_size) {}
+
+void batch_writer::add(int64_t partition_key, CassStatement* statement, query_stats::entry* stats,
+                       execution_profile profile, size_t bytes) {
+    CassBatch* full_batch = nullptr;
+    query_stats::entry* batch_stats = nullptr;
+    size_t batch_bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto it = _open_batches.find(partition_key);
+        if (it == _open_batches.end()) {
+            CassBatch* batch = cass_batch_new(CASS_BATCH_TYPE_UNLOGGED);
+            if (profile == execution_profile::standard) {
+                cass_batch_set_consistency(batch, CASS_CONSISTENCY_QUORUM);
+            } else {
+                cass_batch_set_execution_profile(batch, execution_profile_name(profile));
+                cass_batch_set_is_idempotent(batch, cass_true);
+            }
+            if (stats != nullptr) {
+                batch_stats = &query_stats::get("BATCH " + stats->query_template);
+            }
+            it = _open_batches.emplace(partition_key, open_batch{batch, 0, 0, batch_stats}).first;
+        }
+
+        cass_batch_add_statement(it->second.batch, statement);
+        cass_statement_free(statement);
+        it->second.bytes += bytes;
+
+        if (++it->second.size >= _batch_size) {
+            full_batch = it->second.batch;
+            batch_stats = it->second.stats;
+            batch_bytes = it->second.bytes;
+            _open_batches.erase(it);
+        }
+    }
+
+    if (full_batch != nullptr) {
+        _executor.execute(full_batch, batch_stats, batch_bytes);
+    }
+}
+
+void batch_writer::flush() {
+    std::unordered_map<int64_t, open_batch> open_batches;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        open_batches.swap(_open_batches);
+    }
+
+    for (auto& entry : open_batches) {
+        _executor.execute(entry.second.batch, entry.second.stats, entry.second.bytes);
+    }
+    _executor.flush();
+}
+
+batch_writer::~batch_writer() {
+    for (auto& entry : _open_batches) {
+        cass_batch_free(entry.second.batch);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef SCYLLA_MATRIX_TEST_BATCH_WRITER_HH
+#define SCYLLA_MATRIX_TEST_BATCH_WRITER_HH
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "async_executor.hh"
+
+/* Groups mutations of a single table by partition and sends them as UNLOGGED batches
+ * of at most batch_size statements through an async_executor.
+ * A batch never contains mutations of two different partitions, so it is applied
+ * by the replicas of one partition without extra coordinator work.
+ * Callers identify the partition with any integer encoding of its key;
+ * tables should use separate writers.
+ */
+class batch_writer {
+    struct open_batch {
+        CassBatch* batch;
+        size_t size;
+        size_t bytes;
+        query_stats::entry* stats;
+    };
+
+    async_executor& _executor;
+    size_t _batch_size;
+    std::unordered_map<int64_t, open_batch> _open_batches;
+    std::mutex _mutex;
+
+public:
+    static constexpr size_t default_batch_size = 64;
+
+    explicit batch_writer(async_executor& executor, size_t batch_size = default_batch_size);
+
+    /* Adds a mutation of the given partition and takes ownership of the statement.
+     * A batch is recorded in stats as "BATCH " followed by the template of its first statement,
+     * and is executed with the profile given with its first statement. bytes is the size of the statement
+     * for the statistics; a batch is recorded with the total of its statements.
+     */
+    void add(int64_t partition_key, CassStatement* statement, query_stats::entry* stats = nullptr,
+             execution_profile profile = execution_profile::standard, size_t bytes = 0);
+
+    /* Sends all open batches and waits for every request of the executor. */
+    void flush();
+
+    ~batch_writer();
+};
+
+#endif //SCYLLA_MATRIX_TEST_BATCH_WRITER_HH
@@ -7,7 +7,35 @@
 
 #include "connector.hh"
 
-connector::connector(const char* address, const char* port) {
+namespace {
+    void register_profile(CassCluster* cluster, execution_profile profile, CassConsistency consistency,
+                          unsigned speculative_delay_ms = 0, unsigned speculative_executions = 0) {
+        CassExecProfile* exec_profile = cass_execution_profile_new();
+        CassRetryPolicy* retry_policy = cass_retry_policy_default_new();
+
+        cass_execution_profile_set_consistency(exec_profile, consistency);
+        cass_execution_profile_set_retry_policy(exec_profile, retry_policy);
+        if (speculative_executions != 0) {
+            cass_execution_profile_set_constant_speculative_execution_policy(exec_profile, speculative_delay_ms,
+                                                                             speculative_executions);
+        }
+        cass_cluster_set_execution_profile(cluster, execution_profile_name(profile), exec_profile);
+
+        cass_retry_policy_free(retry_policy);
+        cass_execution_profile_free(exec_profile);
+    }
+}
+
+const char* execution_profile_name(execution_profile profile) {
+    switch (profile) {
+        case execution_profile::bulk_load: return "bulk_load";
+        case execution_profile::hot_read: return "hot_read";
+        case execution_profile::result_write: return "result_write";
+        default: return nullptr;
+    }
+}
+
+connector::connector(const char* address, const char* port, const connector_config& config) {
     _cluster = cass_cluster_new();
     _session = cass_session_new();
 
@@ -19,6 +47,31 @@ connector::connector(const char* address, const char* port) {
     }
 
     cass_cluster_set_protocol_version(_cluster, CASS_PROTOCOL_VERSION_V4);
+
+    if (config.io_threads != 0) {
+        cass_cluster_set_num_threads_io(_cluster, config.io_threads);
+    }
+    if (config.queue_size_io != 0) {
+        cass_cluster_set_queue_size_io(_cluster, config.queue_size_io);
+    }
+    if (config.core_connections_per_host != 0) {
+        cass_cluster_set_core_connections_per_host(_cluster, config.core_connections_per_host);
+    }
+    cass_cluster_set_token_aware_routing(_cluster, config.token_aware_routing ? cass_true : cass_false);
+    cass_cluster_set_latency_aware_routing(_cluster, config.latency_aware_routing ? cass_true : cass_false);
+    if (config.request_timeout_ms != 0) {
+        cass_cluster_set_request_timeout(_cluster, config.request_timeout_ms);
+    }
+    if (config.connect_timeout_ms != 0) {
+        cass_cluster_set_connect_timeout(_cluster, config.connect_timeout_ms);
+    }
+    if (config.shard_aware_port_range_begin != 0 || config.shard_aware_port_range_end != 0) {
+        cass_cluster_set_local_port_range(_cluster, config.shard_aware_port_range_begin, config.shard_aware_port_range_end);
+    }
+    register_profile(_cluster, execution_profile::bulk_load, config.bulk_load_consistency);
+    register_profile(_cluster, execution_profile::hot_read, config.hot_read_consistency,
+                     config.speculative_delay_ms, config.speculative_executions);
+    register_profile(_cluster, execution_profile::result_write, config.result_write_consistency);
     _connect_future = cass_session_connect(_session, _cluster);
 
     if (cass_future_error_code(_connect_future) != CASS_OK) {
@@ -30,7 +83,30 @@ CassSession* const connector::get_session() {
     return _session;
 }
 
+const CassPrepared* connector::prepare(const std::string& query) {
+    std::lock_guard<std::mutex> lock(_prepared_mutex);
+
+    auto it = _prepared.find(query);
+    if (it != _prepared.end()) {
+        return it->second;
+    }
+
+    CassFuture* prepare_future = cass_session_prepare(_session, query.c_str());
+    if (cass_future_error_code(prepare_future) != CASS_OK) {
+        cass_future_free(prepare_future);
+        throw std::runtime_error("Prepare error: " + query);
+    }
+    const CassPrepared* prepared = cass_future_get_prepared(prepare_future);
+    cass_future_free(prepare_future);
+
+    _prepared.emplace(query, prepared);
+    return prepared;
+}
+
 connector::~connector() {
+    for (auto& entry : _prepared) {
+        cass_prepared_free(entry.second);
+    }
     cass_future_free(_connect_future);
     cass_cluster_free(_cluster);
     cass_session_free(_session);
@@ -6,22 +6,80 @@
 #define SCYLLA_MATRIX_TEST_CONNECTOR_HH
 
 #include <cassandra.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/* Named execution profiles registered by every connector, selected per query by operation class.
+ * The named profiles may only be used for idempotent statements, which are marked as such
+ * so that the driver is allowed to retry and speculatively re-execute them.
+ * standard keeps the driver defaults with QUORUM consistency.
+ */
+enum class execution_profile {
+    standard,
+    /* Writes of input matrices */
+    bulk_load,
+    /* Reads of immutable inputs in the multiplication loops, speculatively re-executed on slow replicas */
+    hot_read,
+    /* Writes of multiplication results */
+    result_write
+};
+
+/* Name under which the profile is registered in the cluster, nullptr for standard */
+const char* execution_profile_name(execution_profile profile);
+
+/* Driver tuning for a connection. Zero values keep the driver defaults. */
+struct connector_config {
+    /* Number of driver I/O threads */
+    unsigned io_threads = 0;
+    /* Size of the request queue of every I/O thread */
+    unsigned queue_size_io = 0;
+    /* Connections opened to every host (per I/O thread) */
+    unsigned core_connections_per_host = 0;
+    /* Route requests to a replica owning the partition instead of an arbitrary coordinator */
+    bool token_aware_routing = true;
+    /* Prefer hosts with lower measured latency */
+    bool latency_aware_routing = false;
+    unsigned request_timeout_ms = 0;
+    unsigned connect_timeout_ms = 0;
+    /* Local port range the Scylla driver uses to pick the connection reaching a given shard.
+     * Both zero keeps the default port selection.
+     */
+    int shard_aware_port_range_begin = 0;
+    int shard_aware_port_range_end = 0;
+    /* Consistency levels of the execution profiles */
+    CassConsistency bulk_load_consistency = CASS_CONSISTENCY_QUORUM;
+    CassConsistency hot_read_consistency = CASS_CONSISTENCY_LOCAL_ONE;
+    CassConsistency result_write_consistency = CASS_CONSISTENCY_LOCAL_QUORUM;
+    /* A hot_read request not answered within the delay is sent to another replica,
+     * up to the given number of extra executions. Zero executions disables speculation.
+     */
+    unsigned speculative_delay_ms = 10;
+    unsigned speculative_executions = 2;
+};
 
 /* A class providing an RAII abstraction for Cassandra/Scylla connections. */
 class connector {
     CassCluster* _cluster;
     CassSession* _session;
     CassFuture* _connect_future;
+    std::unordered_map<std::string, const CassPrepared*> _prepared;
+    std::mutex _prepared_mutex;
 
 public:
     /* Create a connection with given address and port */
-    connector(const char* address = nullptr, const char* port = nullptr);
+    connector(const char* address = nullptr, const char* port = nullptr, const connector_config& config = connector_config());
 
     /* Utility function for obtaining session object used in procedures
      * pertaining to the connection.
      */
     CassSession* const get_session();
 
+    /* Returns the prepared statement for the given query template,
+     * preparing it on the server the first time it is requested.
+     */
+    const CassPrepared* prepare(const std::string& query);
+
     ~connector();
 };
 
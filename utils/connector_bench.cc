@@ -0,0 +1,110 @@
+// Measures insert throughput of a connection for different connector_config settings.
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "async_executor.hh"
+#include "connector.hh"
+#include "requestor.hh"
+
+namespace {
+    const std::string keyspace_name = "zpp";
+    const std::string table_name = "connector_bench";
+    const std::string insert_query = "INSERT INTO " + keyspace_name + "." + table_name + " (id, val) VALUES (?, ?);";
+
+    void prepare_table(const char* address) {
+        auto conn = std::make_shared<connector>(address);
+
+        requestor namespace_query(conn);
+        namespace_query << "CREATE KEYSPACE IF NOT EXISTS " << keyspace_name << " WITH REPLICATION = {"
+                           "    'class' : 'SimpleStrategy',"
+                           "    'replication_factor' : 1"
+                           "};";
+        namespace_query.send();
+
+        requestor table_erase(conn);
+        table_erase << "DROP TABLE IF EXISTS " << keyspace_name << "." << table_name << ";";
+        table_erase.send();
+
+        requestor table_query(conn);
+        table_query << "CREATE TABLE " << keyspace_name << "." << table_name << " ("
+                       "    id bigint PRIMARY KEY, "
+                       "    val double "
+                       ");";
+        table_query.send();
+    }
+
+    /* Returns inserted rows per second */
+    double run(const char* address, const connector_config& config, size_t inserts, size_t in_flight) {
+        auto conn = std::make_shared<connector>(address, nullptr, config);
+        async_executor executor(conn, in_flight);
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t k = 0; k < inserts; k++) {
+            requestor query(conn, insert_query);
+            query.bind((int64_t)k, (double)k);
+            query.send(executor);
+        }
+        executor.flush();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        return inserts / elapsed.count();
+    }
+}
+
+/* Usage: connector_bench ADDRESS [INSERTS] [IN_FLIGHT]
+ *        connector_bench ADDRESS INSERTS IN_FLIGHT IO_THREADS CORE_CONNECTIONS TOKEN_AWARE LATENCY_AWARE
+ * Without the connector knobs, sweeps a grid of configurations.
+ */
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " ADDRESS [INSERTS] [IN_FLIGHT]"
+                  << " [IO_THREADS CORE_CONNECTIONS TOKEN_AWARE LATENCY_AWARE]" << std::endl;
+        return 1;
+    }
+
+    const char* address = argv[1];
+    size_t inserts = argc > 2 ? std::stoull(argv[2]) : 100000;
+    size_t in_flight = argc > 3 ? std::stoull(argv[3]) : async_executor::default_max_in_flight;
+
+    std::vector<connector_config> configs;
+    if (argc > 7) {
+        connector_config config;
+        config.io_threads = std::stoul(argv[4]);
+        config.core_connections_per_host = std::stoul(argv[5]);
+        config.token_aware_routing = std::stoi(argv[6]) != 0;
+        config.latency_aware_routing = std::stoi(argv[7]) != 0;
+        configs.push_back(config);
+    } else {
+        for (unsigned io_threads : {1, 2, 4}) {
+            for (unsigned connections : {1, 2, 4}) {
+                for (bool token_aware : {false, true}) {
+                    connector_config config;
+                    config.io_threads = io_threads;
+                    config.core_connections_per_host = connections;
+                    config.token_aware_routing = token_aware;
+                    configs.push_back(config);
+                }
+            }
+        }
+    }
+
+    try {
+        prepare_table(address);
+    } catch (std::exception& e) {
+        std::cerr << "Connection error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "io_threads\tconnections\ttoken_aware\tlatency_aware\tin_flight\tinserts/s" << std::endl;
+    for (auto& config : configs) {
+        double throughput = run(address, config, inserts, in_flight);
+        std::cout << config.io_threads << "\t\t" << config.core_connections_per_host << "\t\t"
+                  << config.token_aware_routing << "\t\t" << config.latency_aware_routing << "\t\t"
+                  << in_flight << "\t\t" << (size_t)throughput << std::endl;
+    }
+
+    return 0;
+}
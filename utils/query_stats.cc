@@ -0,0 +1,202 @@
+#include <cctype>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "query_stats.hh"
+
+namespace {
+    /* Fixed-size open addressing table; entries are never removed */
+    constexpr size_t table_size = 1024;
+    constexpr size_t max_template_length = 160;
+
+    std::atomic<query_stats::entry*> table[table_size];
+    /* Used when the table is full */
+    query_stats::entry overflow_entry("<other>");
+
+    std::mutex counters_mutex;
+    std::map<std::string, std::unique_ptr<std::atomic<uint64_t>>> counters;
+    std::map<std::string, double> values;
+
+    std::atomic<bool> result_bytes_enabled{false};
+
+    size_t bucket_of(uint64_t ns) {
+        if (ns < 8) return ns;
+        int exponent = 63 - __builtin_clzll(ns);
+        return (exponent - 2) * 8 + ((ns >> (exponent - 3)) & 7);
+    }
+
+    /* Smallest latency falling into the bucket after the given one */
+    uint64_t bucket_end(size_t bucket) {
+        bucket++;
+        if (bucket < 8) return bucket;
+        size_t exponent = bucket / 8 + 2;
+        return (8 + bucket % 8) << (exponent - 3);
+    }
+
+    void write_json_string(std::ostream& out, const std::string& text) {
+        out << '"';
+        for (char c : text) {
+            switch (c) {
+                case '"': out << "\\\""; break;
+                case '\\': out << "\\\\"; break;
+                case '\n': out << "\\n"; break;
+                case '\t': out << "\\t"; break;
+                default: out << c;
+            }
+        }
+        out << '"';
+    }
+
+    double percentile_us(const query_stats::entry& stats, uint64_t count, double fraction) {
+        uint64_t rank = static_cast<uint64_t>(fraction * count);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < query_stats::bucket_count; b++) {
+            seen += stats.latency_buckets[b].load(std::memory_order_relaxed);
+            if (seen > rank) {
+                return bucket_end(b) / 1000.0;
+            }
+        }
+        return stats.max_ns.load(std::memory_order_relaxed) / 1000.0;
+    }
+}
+
+query_stats::entry& query_stats::get(const std::string& query_template) {
+    size_t slot = std::hash<std::string>()(query_template) % table_size;
+
+    for (size_t probe = 0; probe < table_size; probe++, slot = (slot + 1) % table_size) {
+        entry* current = table[slot].load(std::memory_order_acquire);
+        if (current == nullptr) {
+            auto* created = new entry(query_template);
+            if (table[slot].compare_exchange_strong(current, created, std::memory_order_acq_rel)) {
+                return *created;
+            }
+            delete created;
+        }
+        if (current->query_template == query_template) {
+            return *current;
+        }
+    }
+
+    return overflow_entry;
+}
+
+std::string query_stats::normalize(const std::string& query) {
+    std::string ret;
+    ret.reserve(std::min(query.size(), max_template_length));
+
+    for (size_t k = 0; k < query.size() && ret.size() < max_template_length; k++) {
+        bool starts_number = std::isdigit(query[k])
+                             && (k == 0 || !(std::isalnum(query[k - 1]) || query[k - 1] == '_'));
+        if (!starts_number) {
+            ret += query[k];
+            continue;
+        }
+        while (k + 1 < query.size() && (std::isalnum(query[k + 1]) || query[k + 1] == '.'
+                                        || ((query[k + 1] == '-' || query[k + 1] == '+')
+                                            && (query[k] == 'e' || query[k] == 'E')))) {
+            k++;
+        }
+        ret += '?';
+    }
+
+    return ret;
+}
+
+void query_stats::record(entry& stats, clock::time_point start, bool error, size_t rows, size_t bytes) {
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+
+    stats.count.fetch_add(1, std::memory_order_relaxed);
+    if (error) {
+        stats.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    stats.rows.fetch_add(rows, std::memory_order_relaxed);
+    stats.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    stats.total_ns.fetch_add(ns, std::memory_order_relaxed);
+    stats.latency_buckets[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = stats.max_ns.load(std::memory_order_relaxed);
+    while (ns > max && !stats.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed));
+}
+
+void query_stats::add_rows(entry& stats, size_t rows, size_t bytes) {
+    stats.rows.fetch_add(rows, std::memory_order_relaxed);
+    stats.bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+std::atomic<uint64_t>& query_stats::counter(const std::string& name) {
+    std::lock_guard<std::mutex> lock(counters_mutex);
+    auto& value = counters[name];
+    if (!value) {
+        value = std::make_unique<std::atomic<uint64_t>>(0);
+    }
+    return *value;
+}
+
+void query_stats::set_count_result_bytes(bool enabled) {
+    result_bytes_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool query_stats::count_result_bytes() {
+    return result_bytes_enabled.load(std::memory_order_relaxed);
+}
+
+void query_stats::set_value(const std::string& name, double value) {
+    std::lock_guard<std::mutex> lock(counters_mutex);
+    values[name] = value;
+}
+
+void query_stats::dump_json(std::ostream& out) {
+    out << "{\n  \"queries\": [";
+
+    bool first = true;
+    auto dump_entry = [&](const entry& stats) {
+        uint64_t count = stats.count.load(std::memory_order_relaxed);
+        if (count == 0) return;
+
+        out << (first ? "\n" : ",\n") << "    {\"query\": ";
+        first = false;
+        write_json_string(out, stats.query_template);
+        out << ", \"count\": " << count
+            << ", \"errors\": " << stats.errors.load(std::memory_order_relaxed)
+            << ", \"rows\": " << stats.rows.load(std::memory_order_relaxed)
+            << ", \"bytes\": " << stats.bytes.load(std::memory_order_relaxed)
+            << ", \"total_ms\": " << stats.total_ns.load(std::memory_order_relaxed) / 1e6
+            << ", \"mean_us\": " << stats.total_ns.load(std::memory_order_relaxed) / 1e3 / count
+            << ", \"p50_us\": " << percentile_us(stats, count, 0.5)
+            << ", \"p90_us\": " << percentile_us(stats, count, 0.9)
+            << ", \"p99_us\": " << percentile_us(stats, count, 0.99)
+            << ", \"p999_us\": " << percentile_us(stats, count, 0.999)
+            << ", \"max_us\": " << stats.max_ns.load(std::memory_order_relaxed) / 1e3 << "}";
+    };
+
+    for (auto& slot : table) {
+        entry* stats = slot.load(std::memory_order_acquire);
+        if (stats != nullptr) {
+            dump_entry(*stats);
+        }
+    }
+    dump_entry(overflow_entry);
+
+    out << "\n  ],\n  \"counters\": {";
+    {
+        std::lock_guard<std::mutex> lock(counters_mutex);
+        first = true;
+        for (auto& [name, value] : counters) {
+            out << (first ? "\n    " : ",\n    ");
+            first = false;
+            write_json_string(out, name);
+            out << ": " << value->load(std::memory_order_relaxed);
+        }
+        out << "\n  },\n  \"values\": {";
+        first = true;
+        for (auto& [name, value] : values) {
+            out << (first ? "\n    " : ",\n    ");
+            first = false;
+            write_json_string(out, name);
+            out << ": " << value;
+        }
+    }
+    out << "\n  }\n}" << std::endl;
+}
@@ -0,0 +1,69 @@
+#ifndef SCYLLA_MATRIX_TEST_QUERY_STATS_HH
+#define SCYLLA_MATRIX_TEST_QUERY_STATS_HH
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+/* Process-wide statistics of executed queries, grouped by query template.
+ * Lookups and updates are lock-free, so they can be used on hot paths of many threads.
+ * Latencies are kept in an HDR-style log-linear histogram (8 sub-buckets per power of two).
+ * Named counters hold other run statistics (e.g. of caches avoiding queries); their lookups
+ * take a lock, so the returned reference should be kept, but updates are lock-free.
+ */
+class query_stats {
+public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr size_t bucket_count = 496;
+
+    struct entry {
+        const std::string query_template;
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> rows{0};
+        /* Sizes of the requests (bound values, or text of unprepared queries) and of the returned row data.
+         * Row data of requestor queries is only counted with set_count_result_bytes(true), since that takes
+         * an extra pass over every result page.
+         */
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> total_ns{0};
+        std::atomic<uint64_t> max_ns{0};
+        std::atomic<uint64_t> latency_buckets[bucket_count] = {};
+
+        explicit entry(std::string query_template) : query_template(std::move(query_template)) {}
+    };
+
+    /* Returns the entry of the given query template, creating it on first use. */
+    static entry& get(const std::string& query_template);
+
+    /* Turns the text of a query with inlined values into its template:
+     * number literals are replaced with '?' and the text is truncated, so queries
+     * differing only in values (or in the length of a collection literal) share an entry.
+     */
+    static std::string normalize(const std::string& query);
+
+    /* Records a finished request that started at the given time. */
+    static void record(entry& stats, clock::time_point start, bool error, size_t rows = 0, size_t bytes = 0);
+
+    /* Records rows of a request returned after it was recorded (e.g. following result pages). */
+    static void add_rows(entry& stats, size_t rows, size_t bytes = 0);
+
+    /* Enables counting the row data of requestor results (off by default). */
+    static void set_count_result_bytes(bool enabled);
+
+    static bool count_result_bytes();
+
+    /* Returns the named counter, creating it on first use. */
+    static std::atomic<uint64_t>& counter(const std::string& name);
+
+    /* Sets a named derived statistic (e.g. a hit rate), dumped next to the counters. */
+    static void set_value(const std::string& name, double value);
+
+    /* Writes statistics of all templates, the counters and the values as a JSON document. */
+    static void dump_json(std::ostream& out);
+};
+
+#endif //SCYLLA_MATRIX_TEST_QUERY_STATS_HH
@@ -2,34 +2,223 @@
 // Created by hayven on 21.11.2020.
 //
 
+#include <stdexcept>
+
 #include "requestor.hh"
 
-requestor::requestor(std::shared_ptr<connector> conn) : _conn(conn) {}
+namespace {
+    /* Size of the row data of a result page: the serialized sizes of all its non-null values.
+     * Zero unless counting it is enabled, as it takes a pass over the whole page.
+     */
+    size_t result_bytes(const CassResult* result) {
+        if (!query_stats::count_result_bytes()) return 0;
+
+        size_t bytes = 0;
+        size_t columns = cass_result_column_count(result);
+        CassIterator* rows = cass_iterator_from_result(result);
+        while (cass_iterator_next(rows)) {
+            const CassRow* row = cass_iterator_get_row(rows);
+            for (size_t index = 0; index < columns; index++) {
+                const cass_byte_t* data;
+                size_t size;
+                if (cass_value_get_bytes(cass_row_get_column(row, index), &data, &size) == CASS_OK) {
+                    bytes += size;
+                }
+            }
+        }
+        cass_iterator_free(rows);
+        return bytes;
+    }
+}
+
+requestor::requestor(std::shared_ptr<connector> conn)
+        : _conn(conn), _statement(nullptr), _result_future(nullptr), _next_page_future(nullptr), _result(nullptr),
+          _iterator(nullptr), _row(nullptr), _prepared(false), _bind_index(0), _bound_bytes(0), _page_size(default_page_size),
+          _profile(execution_profile::standard), _stats(nullptr), _sent_bytes(0) {}
+
+requestor::requestor(std::shared_ptr<connector> conn, const std::string& query_template) : requestor(conn) {
+    _query << query_template;
+    _statement = cass_prepared_bind(_conn->prepare(query_template));
+    _prepared = true;
+}
 
 std::ostream& operator<<(std::ostream& os, requestor& r) {
     os << r._query.str();
     return os;
 }
 
-void requestor::send() {
+query_stats::entry& requestor::stats() {
+    if (_stats == nullptr) {
+        _stats = &query_stats::get(_prepared ? _query.str() : query_stats::normalize(_query.str()));
+    }
+    return *_stats;
+}
+
+size_t requestor::request_bytes() const {
+    return _prepared ? _bound_bytes : _query.str().size();
+}
+
+CassStatement* requestor::build_statement() {
 #ifdef DEBUG
     std::cerr << _query.str() << std::endl;
 #endif
-    _statement = cass_statement_new(_query.str().c_str(), 0);
-    cass_statement_set_consistency(_statement, CASS_CONSISTENCY_QUORUM);
+    CassStatement* statement;
+    if (_prepared) {
+        statement = _statement;
+        _statement = nullptr;
+    } else {
+        statement = cass_statement_new(_query.str().c_str(), 0);
+    }
+    if (_profile == execution_profile::standard) {
+        cass_statement_set_consistency(statement, CASS_CONSISTENCY_QUORUM);
+    } else {
+        cass_statement_set_execution_profile(statement, execution_profile_name(_profile));
+        cass_statement_set_is_idempotent(statement, cass_true);
+    }
+    return statement;
+}
 
-    _result_future = cass_session_execute(_conn->get_session(), _statement);
+void requestor::bind_value(int32_t value) {
+    if (cass_statement_bind_int32(_statement, _bind_index++, value) != CASS_OK) {
+        throw std::runtime_error("Bind error");
+    }
+    _bound_bytes += sizeof(value);
+}
+
+void requestor::bind_value(int64_t value) {
+    if (cass_statement_bind_int64(_statement, _bind_index++, value) != CASS_OK) {
+        throw std::runtime_error("Bind error");
+    }
+    _bound_bytes += sizeof(value);
+}
+
+void requestor::bind_value(float value) {
+    if (cass_statement_bind_float(_statement, _bind_index++, value) != CASS_OK) {
+        throw std::runtime_error("Bind error");
+    }
+    _bound_bytes += sizeof(value);
+}
+
+void requestor::bind_value(double value) {
+    if (cass_statement_bind_double(_statement, _bind_index++, value) != CASS_OK) {
+        throw std::runtime_error("Bind error");
+    }
+    _bound_bytes += sizeof(value);
+}
+
+void requestor::bind_value(const std::vector<uint8_t>& bytes) {
+    if (cass_statement_bind_bytes(_statement, _bind_index++, bytes.data(), bytes.size()) != CASS_OK) {
+        throw std::runtime_error("Bind error");
+    }
+    _bound_bytes += bytes.size();
+}
+
+void requestor::decode(const CassValue* value, int32_t& out) {
+    if (cass_value_get_int32(value, &out) != CASS_OK) {
+        throw std::runtime_error("Decode error");
+    }
+}
+
+void requestor::decode(const CassValue* value, int64_t& out) {
+    if (cass_value_get_int64(value, &out) != CASS_OK) {
+        throw std::runtime_error("Decode error");
+    }
+}
+
+void requestor::decode(const CassValue* value, float& out) {
+    if (cass_value_get_float(value, &out) != CASS_OK) {
+        throw std::runtime_error("Decode error");
+    }
+}
 
+void requestor::decode(const CassValue* value, double& out) {
+    if (cass_value_get_double(value, &out) != CASS_OK) {
+        throw std::runtime_error("Decode error");
+    }
+}
+
+requestor& requestor::set_page_size(int page_size) {
+    _page_size = page_size;
+    return *this;
+}
+
+requestor& requestor::set_profile(execution_profile profile) {
+    _profile = profile;
+    return *this;
+}
+
+void requestor::prefetch_next_page() {
+    if (!cass_result_has_more_pages(_result)) return;
+
+    cass_statement_set_paging_state(_statement, _result);
+    _next_page_future = cass_session_execute(_conn->get_session(), _statement);
+}
+
+bool requestor::advance_page() {
+    if (_next_page_future == nullptr) return false;
+
+    cass_iterator_free(_iterator);
+    cass_result_free(_result);
+    cass_future_free(_result_future);
+    _iterator = nullptr;
+    _result = nullptr;
+    _result_future = _next_page_future;
+    _next_page_future = nullptr;
+
+    if (cass_future_error_code(_result_future) != CASS_OK) {
+        throw std::runtime_error("Query error");
+    }
+    _result = cass_future_get_result(_result_future);
+    _iterator = cass_iterator_from_result(_result);
+    query_stats::add_rows(stats(), cass_result_row_count(_result), result_bytes(_result));
+    prefetch_next_page();
+    return true;
+}
+
+void requestor::await_result() {
     if (cass_future_error_code(_result_future) == CASS_OK) {
         _result = cass_future_get_result(_result_future);
         _iterator = cass_iterator_from_result(_result);
+        query_stats::record(stats(), _sent_at, false, cass_result_row_count(_result),
+                            _sent_bytes + result_bytes(_result));
+        prefetch_next_page();
     } else {
+        query_stats::record(stats(), _sent_at, true, 0, _sent_bytes);
         throw std::runtime_error("Query error");
     }
 }
 
+void requestor::send_async() {
+    _sent_bytes = request_bytes();
+    _statement = build_statement();
+    cass_statement_set_paging_size(_statement, _page_size);
+
+    _sent_at = query_stats::clock::now();
+    _result_future = cass_session_execute(_conn->get_session(), _statement);
+}
+
+void requestor::send() {
+    send_async();
+    await_result();
+}
+
+void requestor::send(async_executor& executor) {
+    size_t bytes = request_bytes();
+    executor.execute(build_statement(), &stats(), bytes);
+}
+
+void requestor::send(batch_writer& writer, int64_t partition_key) {
+    size_t bytes = request_bytes();
+    writer.add(partition_key, build_statement(), &stats(), _profile, bytes);
+}
+
 bool requestor::next_row() {
-    if (!cass_iterator_next(_iterator)) return false;
+    if (_iterator == nullptr) {
+        await_result();
+    }
+    while (!cass_iterator_next(_iterator)) {
+        if (!advance_page()) return false;
+    }
 
     _row = cass_iterator_get_row(_iterator);
     return true;
@@ -39,9 +228,27 @@ const CassValue* requestor::get_column(std::string name) {
     return cass_row_get_column_by_name(_row, name.c_str());
 }
 
+size_t requestor::column_index(const std::string& name) const {
+    size_t count = cass_result_column_count(_result);
+    for (size_t index = 0; index < count; index++) {
+        const char* column_name;
+        size_t column_name_length;
+        if (cass_result_column_name(_result, index, &column_name, &column_name_length) == CASS_OK
+            && name.compare(0, std::string::npos, column_name, column_name_length) == 0) {
+            return index;
+        }
+    }
+    throw std::runtime_error("No column " + name + " in the response");
+}
+
+const CassValue* requestor::get_column(size_t index) {
+    return cass_row_get_column(_row, index);
+}
+
 requestor::~requestor() {
-    cass_iterator_free(_iterator);
-    cass_result_free(_result);
-    cass_future_free(_result_future);
-    cass_statement_free(_statement);
+    if (_iterator != nullptr) cass_iterator_free(_iterator);
+    if (_result != nullptr) cass_result_free(_result);
+    if (_result_future != nullptr) cass_future_free(_result_future);
+    if (_next_page_future != nullptr) cass_future_free(_next_page_future);
+    if (_statement != nullptr) cass_statement_free(_statement);
 }
\ No newline at end of file
@@ -5,11 +5,17 @@
 #ifndef SCYLLA_MATRIX_TEST_REQUESTOR_HH
 #define SCYLLA_MATRIX_TEST_REQUESTOR_HH
 
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <sstream>
+#include <string>
+#include <vector>
 
+#include "async_executor.hh"
+#include "batch_writer.hh"
 #include "connector.hh"
+#include "query_stats.hh"
 
 /* A class providing an additional layer of abstraction
  * for Scylla's C++ driver's query/response mechanism
@@ -21,14 +27,71 @@ class requestor {
     std::shared_ptr<connector> _conn;
     CassStatement* _statement;
     CassFuture* _result_future;
+    CassFuture* _next_page_future;
     const CassResult* _result;
     CassIterator* _iterator;
     const CassRow* _row;
+    bool _prepared;
+    size_t _bind_index;
+    /* Total size of the values bound so far */
+    size_t _bound_bytes;
+    int _page_size;
+    execution_profile _profile;
+    query_stats::entry* _stats;
+    /* Start and size of a request sent with send_async(), recorded once its response is awaited */
+    query_stats::clock::time_point _sent_at;
+    size_t _sent_bytes;
+
+    /* Statistics entry of the query template, looked up on first use */
+    query_stats::entry& stats();
+
+    /* Size of the request: the bound values of a prepared query, the text of any other one */
+    size_t request_bytes() const;
+
+    /* Creates a statement out of the query string, or hands over the bound prepared statement. */
+    CassStatement* build_statement();
+
+    /* Starts fetching the page following the current result, if there is one. */
+    void prefetch_next_page();
+
+    /* Replaces the current result with the prefetched page. Returns false if there is none. */
+    bool advance_page();
+
+    /* Waits for the response of the sent request and records it. Throws if the request failed. */
+    void await_result();
+
+    void bind_value(int32_t value);
+    void bind_value(int64_t value);
+    void bind_value(float value);
+    void bind_value(double value);
+    void bind_value(const std::vector<uint8_t>& bytes);
+
+    void decode(const CassValue* value, int32_t& out);
+    void decode(const CassValue* value, int64_t& out);
+    void decode(const CassValue* value, float& out);
+    void decode(const CassValue* value, double& out);
 
 public:
+    static constexpr int default_page_size = 5000;
+
     /* Creates a new requestor using connection represented by a given connector */
     requestor(std::shared_ptr<connector> conn);
 
+    /* Creates a requestor executing a query template prepared through (and cached by) the connector.
+     * Values for its markers have to be passed with bind() instead of operator<<.
+     */
+    requestor(std::shared_ptr<connector> conn, const std::string& query_template);
+
+    /* Binds the next markers of a prepared query, in order. The types have to match
+     * the column types exactly: int32_t for int, int64_t for bigint, float, double,
+     * std::vector<uint8_t> for blob.
+     */
+    template<typename... Args>
+    requestor& bind(const Args&... args) {
+        (bind_value(args), ...);
+        return *this;
+    }
+
     /* Appends new elements to the query string */
     template<typename T>
     requestor& operator<<(T t) {
@@ -36,6 +99,15 @@ public:
         return *this;
     }
 
+    /* Sets the number of rows fetched per page. Has to be called before send(). */
+    requestor& set_page_size(int page_size);
+
+    /* Selects the execution profile of the query. Has to be called before send().
+     * Any profile other than standard marks the query as idempotent.
+     * Queries added to a batch_writer share the profile of the first query of the batch.
+     */
+    requestor& set_profile(execution_profile profile);
+
     /* Writes out the query text */
     friend std::ostream& operator<<(std::ostream& os, requestor& r);
 
@@ -45,14 +117,69 @@ public:
      */
     void send();
 
+    /* Sends the query without waiting for the response, so that other work (or other requests)
+     * can proceed while it is executed. The response is awaited by the first call to next_row(),
+     * which throws if the request failed. The recorded latency includes the time until then.
+     */
+    void send_async();
+
+    /* Hands the query over to the executor instead of waiting for the response.
+     * Errors are reported by the executor. The response is not available.
+     */
+    void send(async_executor& executor);
+
+    /* Adds the query to a batch of mutations of the given partition.
+     * Errors are reported by the executor of the writer. The response is not available.
+     */
+    void send(batch_writer& writer, int64_t partition_key);
+
     /* Prepares the next row of the request response.
      * Returns true if successful, false if there are no rows left to process.
+     * Rows are streamed across result pages; the next page is fetched in the background
+     * while the current one is being processed.
      */
     bool next_row();
 
     /* Get the CassValue for given column in the currently processed row. */
     const CassValue* get_column(std::string name);
 
+    /* Resolves the position of a column in the rows of the response. Throws if there is no such column.
+     * Positions are the same on every page, so they should be resolved once, before iterating the rows.
+     */
+    size_t column_index(const std::string& name) const;
+
+    /* Get the CassValue at the given position in the currently processed row. */
+    const CassValue* get_column(size_t index);
+
+    /* Decodes the value at the given position in the currently processed row.
+     * V has to match the column type exactly, as in bind().
+     */
+    template<typename V>
+    V get(size_t index) {
+        V value;
+        decode(get_column(index), value);
+        return value;
+    }
+
+    /* Decodes all remaining rows of the response into matrix values (anything constructible
+     * from row, column and value), resolving the columns once.
+     * I, J and V are the types of the row, column and value columns. Returns the number of rows read.
+     */
+    template<typename I, typename J, typename V, typename Value>
+    size_t read_values(std::vector<Value>& out, const std::string& row_column,
+                       const std::string& column_column, const std::string& value_column) {
+        size_t i_index = column_index(row_column);
+        size_t j_index = column_index(column_column);
+        size_t val_index = column_index(value_column);
+
+        size_t read = 0;
+        while (next_row()) {
+            out.emplace_back(get<I>(i_index), get<J>(j_index), get<V>(val_index));
+            read++;
+        }
+        return read;
+    }
+
     ~requestor();
 };
 
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+/* Small counter-based random bit generator (SplitMix64).
+ * Seeding is free, so a fresh instance can be derived for every independent
+ * stream of values. Satisfies the UniformRandomBitGenerator requirements.
+ */
+class splitmix64 {
+    uint64_t _state;
+
+public:
+    using result_type = uint64_t;
+
+    explicit splitmix64(uint64_t seed = 0) : _state(seed) {}
+
+    /* Bijective 64-bit finalizer, usable as a hash for deriving seeds. */
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    static constexpr result_type min() {
+        return std::numeric_limits<result_type>::min();
+    }
+
+    static constexpr result_type max() {
+        return std::numeric_limits<result_type>::max();
+    }
+
+    result_type operator()() {
+        _state += 0x9e3779b97f4a7c15ULL;
+        return mix(_state);
+    }
+};
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+#include "work_stealing_pool.hh"
+
+work_stealing_pool::work_stealing_pool(size_t threads) : _threads(threads) {
+    if (_threads == 0) {
+        _threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+bool work_stealing_pool::take_task(std::vector<worker_queue>& queues, size_t worker, size_t& task) {
+    {
+        std::lock_guard<std::mutex> lock(queues[worker].mutex);
+        if (!queues[worker].tasks.empty()) {
+            task = queues[worker].tasks.front();
+            queues[worker].tasks.pop_front();
+            return true;
+        }
+    }
+
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        worker_queue& victim = queues[(worker + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void work_stealing_pool::run(size_t task_count, const std::function<void(size_t task, size_t worker)>& body) {
+    size_t threads = std::min(_threads, std::max<size_t>(task_count, 1));
+    std::vector<worker_queue> queues(threads);
+    for (size_t task = 0; task < task_count; task++) {
+        queues[task % threads].tasks.push_back(task);
+    }
+
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto work = [&](size_t worker) {
+        size_t task;
+        while (!failed.load() && take_task(queues, worker, task)) {
+            try {
+                body(task, worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!failed.exchange(true)) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t worker = 1; worker < threads; worker++) {
+        workers.emplace_back(work, worker);
+    }
+    work(0);
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+size_t work_stealing_pool::threads() const {
+    return _threads;
+}
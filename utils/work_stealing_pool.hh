@@ -0,0 +1,40 @@
+#ifndef SCYLLA_MATRIX_TEST_WORK_STEALING_POOL_HH
+#define SCYLLA_MATRIX_TEST_WORK_STEALING_POOL_HH
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/* Runs a set of independent, numbered tasks on a fixed number of threads.
+ * Tasks are dealt round-robin to per-worker queues, so an ordered task list keeps
+ * roughly its order globally. A worker takes its own tasks from the front and,
+ * once its queue is empty, steals from the back of the other queues.
+ * Meant for coarse tasks; the queues are guarded by plain mutexes.
+ */
+class work_stealing_pool {
+    struct worker_queue {
+        std::deque<size_t> tasks;
+        std::mutex mutex;
+    };
+
+    size_t _threads;
+
+    /* Takes the next task of the worker, stealing if needed. Returns false when no tasks are left. */
+    static bool take_task(std::vector<worker_queue>& queues, size_t worker, size_t& task);
+
+public:
+    /* Zero threads means one per hardware thread. */
+    explicit work_stealing_pool(size_t threads = 0);
+
+    /* Runs body(task, worker) for every task in [0; task_count) and waits for all of them.
+     * worker is in [0; threads()) and identifies the calling thread, e.g. to select per-worker state.
+     * If a task throws, the remaining tasks are dropped and the first exception is rethrown.
+     */
+    void run(size_t task_count, const std::function<void(size_t task, size_t worker)>& body);
+
+    size_t threads() const;
+};
+
+#endif //SCYLLA_MATRIX_TEST_WORK_STEALING_POOL_HH
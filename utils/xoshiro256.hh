@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "splitmix64.hh"
+
+/* xoshiro256+ generator running a fixed number of independent lanes side by side.
+ * The state is kept in structure-of-arrays layout, so stepping all lanes at once
+ * compiles to plain SIMD arithmetic. The output stream is the sequence of lane
+ * blocks, which only depends on the seed.
+ */
+class xoshiro256_lanes {
+public:
+    static constexpr size_t lanes = 8;
+
+private:
+    uint64_t _s0[lanes], _s1[lanes], _s2[lanes], _s3[lanes];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+public:
+    explicit xoshiro256_lanes(uint64_t seed) {
+        splitmix64 seeder(seed);
+        for (size_t l = 0; l < lanes; l++) {
+            _s0[l] = seeder();
+            _s1[l] = seeder();
+            _s2[l] = seeder();
+            _s3[l] = seeder();
+        }
+    }
+
+    /* Writes the next value of every lane to out. */
+    void next(uint64_t* out) {
+        for (size_t l = 0; l < lanes; l++) {
+            out[l] = _s0[l] + _s3[l];
+            uint64_t t = _s1[l] << 17;
+            _s2[l] ^= _s0[l];
+            _s3[l] ^= _s1[l];
+            _s1[l] ^= _s2[l];
+            _s0[l] ^= _s3[l];
+            _s2[l] ^= t;
+            _s3[l] = rotl(_s3[l], 45);
+        }
+    }
+};
+
+/* Uniform real numbers from [min; max) generated in lane blocks of xoshiro256_lanes.
+ * Values taken one by one and in bulk come from the same stream, so any mix of
+ * next() and fill() calls yields the same sequence for a given seed.
+ */
+template<class V>
+class uniform_real_lanes {
+    xoshiro256_lanes _rng;
+    V _min, _scale;
+    V _buffer[xoshiro256_lanes::lanes];
+    size_t _buffer_pos;
+
+    /* Top mantissa-width bits of a random word, scaled to [0; 1) */
+    static V to_unit(uint64_t x) {
+        if constexpr (sizeof(V) == sizeof(float)) {
+            return static_cast<V>(x >> 40) * static_cast<V>(1.0 / (1ULL << 24));
+        } else {
+            return static_cast<V>(x >> 11) * static_cast<V>(1.0 / (1ULL << 53));
+        }
+    }
+
+    void generate_block(V* out) {
+        uint64_t raw[xoshiro256_lanes::lanes];
+        _rng.next(raw);
+        for (size_t l = 0; l < xoshiro256_lanes::lanes; l++) {
+            out[l] = _min + _scale * to_unit(raw[l]);
+        }
+    }
+
+public:
+    uniform_real_lanes(V min, V max, uint64_t seed)
+            : _rng(seed), _min(min), _scale(max - min), _buffer_pos(xoshiro256_lanes::lanes) {}
+
+    V next() {
+        if (_buffer_pos == xoshiro256_lanes::lanes) {
+            generate_block(_buffer);
+            _buffer_pos = 0;
+        }
+        return _buffer[_buffer_pos++];
+    }
+
+    void fill(V* out, size_t count) {
+        while (count > 0 && _buffer_pos < xoshiro256_lanes::lanes) {
+            *out++ = _buffer[_buffer_pos++];
+            count--;
+        }
+        while (count >= xoshiro256_lanes::lanes) {
+            generate_block(out);
+            out += xoshiro256_lanes::lanes;
+            count -= xoshiro256_lanes::lanes;
+        }
+        for (; count > 0; count--) {
+            *out++ = next();
+        }
+    }
+};